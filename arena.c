@@ -0,0 +1,84 @@
+#include "arena.h"
+
+#include <string.h>
+
+#define TAG "PanisArena"
+
+#define ARENA_SIZE                                                            \
+    (ARENA_BUDGET_GAME + ARENA_BUDGET_AUDIO + ARENA_BUDGET_LEVEL_FILE +      \
+     ARENA_BUDGET_INPUT_LOG + ARENA_BUDGET_RESUME + ARENA_BUDGET_PREFETCH +   \
+     ARENA_BUDGET_ASSETS)
+
+typedef struct {
+    const char* name;
+    size_t budget;
+    size_t start;  // Offset of the budget in the arena
+    size_t used;
+    size_t peak;
+} ArenaRegion;
+
+static ArenaRegion regions[ArenaCount] = {
+    [ArenaGame] = {"Game", ARENA_BUDGET_GAME, 0, 0, 0},
+    [ArenaAudio] = {"Audio", ARENA_BUDGET_AUDIO, 0, 0, 0},
+    [ArenaLevelFile] = {"LevelFile", ARENA_BUDGET_LEVEL_FILE, 0, 0, 0},
+    [ArenaInputLog] = {"InputLog", ARENA_BUDGET_INPUT_LOG, 0, 0, 0},
+    [ArenaResume] = {"Resume", ARENA_BUDGET_RESUME, 0, 0, 0},
+    [ArenaPrefetch] = {"Prefetch", ARENA_BUDGET_PREFETCH, 0, 0, 0},
+    [ArenaAssets] = {"Assets", ARENA_BUDGET_ASSETS, 0, 0, 0},
+};
+
+static uint8_t arena_memory[ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+
+// ARENA_ALIGN is a power of two, so this checks every budget is a multiple
+_Static_assert(
+    (ARENA_BUDGET_GAME | ARENA_BUDGET_AUDIO | ARENA_BUDGET_LEVEL_FILE | ARENA_BUDGET_INPUT_LOG |
+     ARENA_BUDGET_RESUME | ARENA_BUDGET_PREFETCH | ARENA_BUDGET_ASSETS) % ARENA_ALIGN == 0,
+    "Budgets must keep the alignment");
+
+void arena_init(void) {
+    size_t start = 0;
+    for(int i = 0; i < ArenaCount; i++) {
+        regions[i].start = start;
+        regions[i].used = 0;
+        regions[i].peak = 0;
+        start += regions[i].budget;
+    }
+    furi_assert(start == ARENA_SIZE);
+}
+
+void* arena_alloc(Arena arena, size_t size) {
+    ArenaRegion* region = &regions[arena];
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if(size > region->budget - region->used) {
+        FURI_LOG_E(
+            TAG,
+            "%s budget of %zu bytes exceeded by %zu bytes",
+            region->name,
+            region->budget,
+            size - (region->budget - region->used));
+        furi_crash("Arena budget exceeded");
+    }
+    void* memory = &arena_memory[region->start + region->used];
+    region->used += size;
+    if(region->used > region->peak) {
+        region->peak = region->used;
+    }
+    memset(memory, 0, size);
+    return memory;
+}
+
+void arena_reset(Arena arena) {
+    regions[arena].used = 0;
+}
+
+void arena_log_usage(void) {
+    for(int i = 0; i < ArenaCount; i++) {
+        FURI_LOG_I(
+            TAG,
+            "%s: %zu bytes used, peak %zu of %zu",
+            regions[i].name,
+            regions[i].used,
+            regions[i].peak,
+            regions[i].budget);
+    }
+}
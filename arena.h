@@ -0,0 +1,43 @@
+#pragma once
+
+#include <furi.h>
+
+// Memory of the app, reserved once as a static block and split into fixed
+// budgets per subsystem. Each budget is a bump allocator that is emptied as
+// a whole, so nothing the app allocates itself can fragment the heap. Firmware
+// objects (threads, queues, files, the icon decoder) still come from the heap.
+
+// Budgets in bytes. A module checks its own structures against its budget at
+// compile time, the log at exit shows the peak use of each.
+#define ARENA_BUDGET_GAME 5632       // GameState and the progress to save
+#define ARENA_BUDGET_AUDIO 128       // AudioPlayer
+#define ARENA_BUDGET_LEVEL_FILE 128  // LevelFile
+#define ARENA_BUDGET_INPUT_LOG 512   // The one InputLog, recording or replay
+#define ARENA_BUDGET_RESUME 704      // File buffer while saving or resuming
+#define ARENA_BUDGET_PREFETCH 96     // ChunkPrefetcher
+#define ARENA_BUDGET_ASSETS 2176     // AssetCache with its decoded images
+#define ARENA_ALIGN 8                // Every allocation is aligned to this
+
+typedef enum {
+    ArenaGame,
+    ArenaAudio,
+    ArenaLevelFile,
+    ArenaInputLog,
+    ArenaResume,
+    ArenaPrefetch,
+    ArenaAssets,
+    ArenaCount,
+} Arena;
+
+// Empty all budgets and reset their statistics
+void arena_init(void);
+
+// Allocate zeroed memory from a budget. Running out of a budget is a bug,
+// it stops the app with an error naming the budget.
+void* arena_alloc(Arena arena, size_t size);
+
+// Free everything allocated from a budget
+void arena_reset(Arena arena);
+
+// Log current and peak use of every budget
+void arena_log_usage(void);
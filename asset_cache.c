@@ -0,0 +1,169 @@
+#include "asset_cache.h"
+#include "arena.h"
+
+#define TAG "PanisAssets"
+
+#define ASSET_HEADER_SIZE 10
+#define ASSET_READ_SIZE 64  // Coded bytes read from the file at a time
+
+static const char* const asset_paths[AssetCount] = {
+    [AssetToasterOfDeath] = APP_ASSETS_PATH("toaster_of_death.pnb"),
+};
+
+typedef struct {
+    AssetImage image;
+    int8_t asset;       // Asset decoded into this slot, -1 if empty
+    uint32_t last_use;  // AssetCache.uses when it was last got
+    uint8_t bits[ASSET_MAX_BYTES];
+} AssetSlot;
+
+struct AssetCache {
+    Storage* storage;
+    uint32_t uses;    // Calls of asset_cache_get
+    uint32_t failed;  // Bit per asset that could not be loaded
+    AssetSlot slots[ASSET_CACHE_SLOTS];
+};
+
+_Static_assert(sizeof(AssetCache) <= ARENA_BUDGET_ASSETS, "AssetCache exceeds its arena budget");
+_Static_assert(AssetCount <= 32, "Failed assets are tracked in one word");
+
+// Coded data of a file, read in small pieces
+typedef struct {
+    File* file;
+    size_t remaining;  // Coded bytes not read from the file yet
+    uint8_t buffer[ASSET_READ_SIZE];
+    size_t pos;
+    size_t size;
+} AssetReader;
+
+// Get the next coded byte, false at the end of the data or on a read error
+static bool reader_next(AssetReader* reader, uint8_t* byte) {
+    if(reader->pos == reader->size) {
+        size_t size = MIN(reader->remaining, sizeof(reader->buffer));
+        if(size == 0 || storage_file_read(reader->file, reader->buffer, size) != size) {
+            return false;
+        }
+        reader->remaining -= size;
+        reader->pos = 0;
+        reader->size = size;
+    }
+    *byte = reader->buffer[reader->pos++];
+    return true;
+}
+
+// Undo the PackBits coding until `size` bytes are decoded
+static bool decode_bits(AssetReader* reader, uint8_t* bits, size_t size) {
+    size_t pos = 0;
+    while(pos < size) {
+        uint8_t control, byte;
+        if(!reader_next(reader, &control)) {
+            return false;
+        }
+        if(control < 128) {
+            // Literal bytes
+            size_t count = control + 1;
+            if(pos + count > size) {
+                return false;
+            }
+            for(size_t i = 0; i < count; i++) {
+                if(!reader_next(reader, &bits[pos++])) {
+                    return false;
+                }
+            }
+        } else {
+            // One byte repeated
+            size_t count = control - 126;
+            if(pos + count > size || !reader_next(reader, &byte)) {
+                return false;
+            }
+            memset(&bits[pos], byte, count);
+            pos += count;
+        }
+    }
+    return true;
+}
+
+// Read and decode an asset file into a slot
+static bool load_asset(AssetCache* cache, Asset asset, AssetSlot* slot) {
+    File* file = storage_file_alloc(cache->storage);
+    uint8_t header[ASSET_HEADER_SIZE];
+    bool loaded = false;
+    do {
+        if(!storage_file_open(file, asset_paths[asset], FSAM_READ, FSOM_OPEN_EXISTING)) {
+            FURI_LOG_W(TAG, "%s is missing", asset_paths[asset]);
+            break;
+        }
+        if(storage_file_read(file, header, sizeof(header)) != sizeof(header) ||
+           memcmp(header, "PNBM", 4) != 0 || header[4] != ASSET_FILE_VERSION) {
+            FURI_LOG_W(TAG, "Unknown image format");
+            break;
+        }
+        uint8_t width = header[5];
+        uint8_t height = header[6];
+        if(width == 0 || width > ASSET_MAX_WIDTH || height == 0 || height > ASSET_MAX_HEIGHT) {
+            FURI_LOG_W(TAG, "Image size %ux%u not supported", width, height);
+            break;
+        }
+        AssetReader reader = {
+            .file = file,
+            .remaining = header[8] | (header[9] << 8),
+            .pos = 0,
+            .size = 0,
+        };
+        if(!decode_bits(&reader, slot->bits, (width + 7) / 8 * height)) {
+            FURI_LOG_W(TAG, "%s is corrupt", asset_paths[asset]);
+            break;
+        }
+        slot->image.width = width;
+        slot->image.height = height;
+        slot->image.bits = slot->bits;
+        loaded = true;
+    } while(false);
+    storage_file_close(file);
+    storage_file_free(file);
+    return loaded;
+}
+
+AssetCache* asset_cache_alloc(Storage* storage) {
+    AssetCache* cache = arena_alloc(ArenaAssets, sizeof(AssetCache));
+    cache->storage = storage;
+    for(int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        cache->slots[i].asset = -1;
+    }
+    return cache;
+}
+
+void asset_cache_free(AssetCache* cache) {
+    UNUSED(cache);
+    arena_reset(ArenaAssets);
+}
+
+const AssetImage* asset_cache_get(AssetCache* cache, Asset asset) {
+    furi_assert(asset < AssetCount);
+    if(cache->failed & (1UL << asset)) {
+        return NULL;
+    }
+    cache->uses++;
+    
+    // Already decoded, else replace the least recently used slot
+    AssetSlot* slot = &cache->slots[0];
+    for(int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        if(cache->slots[i].asset == (int8_t)asset) {
+            cache->slots[i].last_use = cache->uses;
+            return &cache->slots[i].image;
+        }
+        if(cache->slots[i].last_use < slot->last_use) {
+            slot = &cache->slots[i];
+        }
+    }
+    slot->asset = -1;
+    slot->last_use = 0;
+    if(!load_asset(cache, asset, slot)) {
+        cache->failed |= 1UL << asset;
+        return NULL;
+    }
+    slot->asset = asset;
+    slot->last_use = cache->uses;
+    FURI_LOG_I(TAG, "Loaded %s", asset_paths[asset]);
+    return &slot->image;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <furi.h>
+#include <storage/storage.h>
+
+// Large images, streamed from the app's assets on the SD card instead of
+// being compiled into the app like the sprites in images/. Each is a PNBM
+// file made by tools/art_compiler.py from the illustrations in art/: a 1-bit
+// image of at most the screen size, PackBits coded. Decoded images are kept
+// in a few slots, the least recently used one is replaced.
+
+#define ASSET_MAX_WIDTH 128
+#define ASSET_MAX_HEIGHT 64
+#define ASSET_MAX_BYTES (ASSET_MAX_WIDTH * ASSET_MAX_HEIGHT / 8)
+#define ASSET_CACHE_SLOTS 2  // Images decoded at the same time
+#define ASSET_FILE_VERSION 1
+
+typedef enum {
+    AssetToasterOfDeath,  // Title art: a toaster chasing Panis
+    AssetCount,
+} Asset;
+
+// A decoded image, XBM rows for canvas_draw_xbm
+typedef struct {
+    uint8_t width;
+    uint8_t height;
+    const uint8_t* bits;
+} AssetImage;
+
+typedef struct AssetCache AssetCache;
+
+AssetCache* asset_cache_alloc(Storage* storage);
+
+void asset_cache_free(AssetCache* cache);
+
+// Get an image, read from the SD card the first time it is needed. NULL if
+// its file is missing or invalid, that is not retried. The image stays valid
+// until ASSET_CACHE_SLOTS other images were got.
+const AssetImage* asset_cache_get(AssetCache* cache, Asset asset);
@@ -0,0 +1,259 @@
+#include "audio.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <furi_hal.h>
+
+#define AUDIO_QUEUE_SIZE 8
+#define AUDIO_STACK_SIZE 1024
+#define AUDIO_VOLUME 1.0f
+#define AUDIO_ACQUIRE_TIMEOUT_MS 100
+#define AUDIO_TONE_PERCENT 90  // Rest of each note is silence between notes
+
+// Note of a sound: frequency (Hz), duration (ms)
+typedef struct {
+    float freq;
+    uint16_t duration;
+} Note;
+
+// Melody 'Little things'
+static const Note melody_notes[] = {
+    // Measure 1: E4, C5, E5, C5, E5
+    {329.63f, 454},  // E4 quarter
+    {523.25f, 227},  // C5 eighth
+    {659.25f, 227},  // E5 eighth
+    {523.25f, 227},  // C5 eighth
+    {659.25f, 227},  // E5 eighth
+    
+    // Measure 2: B4 (dotted half)
+    {493.88f, 1364}, // B4 dotted half
+    
+    // Measure 3: B4, C5, E5, C5, E5
+    {493.88f, 454},  // B4 quarter
+    {523.25f, 227},  // C5 eighth
+    {659.25f, 227},  // E5 eighth
+    {523.25f, 227},  // C5 eighth
+    {659.25f, 227},  // E5 eighth
+    
+    // Measure 4: B4 (dotted half)
+    {493.88f, 1364}  // B4 dotted half
+};
+
+// Short rising blip
+static const Note pill_notes[] = {
+    {1318.51f, 40},  // E6
+    {1760.00f, 60},  // A6
+};
+
+// Little arpeggio
+static const Note diamond_notes[] = {
+    {880.00f, 40},   // A5
+    {1174.66f, 40},  // D6
+    {1567.98f, 80},  // G6
+};
+
+// Low thud
+static const Note bump_notes[] = {
+    {130.81f, 50},   // C3
+};
+
+typedef struct {
+    const Note* notes;
+    uint8_t count;
+    bool is_effect;  // Sound effects take precedence over the melody
+} Sound;
+
+static const Sound sounds[AudioSoundCount] = {
+    [AudioSoundMelody] = {melody_notes, COUNT_OF(melody_notes), false},
+    [AudioSoundPill] = {pill_notes, COUNT_OF(pill_notes), true},
+    [AudioSoundDiamond] = {diamond_notes, COUNT_OF(diamond_notes), true},
+    [AudioSoundBump] = {bump_notes, COUNT_OF(bump_notes), true},
+};
+
+// Message for the worker, a sound or the exit request
+#define AUDIO_COMMAND_EXIT AudioSoundCount
+
+// Playback position within a sound
+typedef struct {
+    const Note* notes;
+    uint8_t count;
+    uint8_t next;  // Index of the next note to start
+} Channel;
+
+typedef enum {
+    PhaseIdle,  // Nothing playing, speaker released
+    PhaseTone,  // A note is sounding
+    PhaseGap,   // Silence after a note
+} Phase;
+
+struct AudioPlayer {
+    FuriThread* thread;
+    FuriMessageQueue* queue;
+    
+    // Sequencer state, owned by the worker thread
+    Channel music;
+    Channel effect;
+    Phase phase;
+    bool music_note;         // True if the current note belongs to the melody
+    bool speaker_acquired;
+    uint32_t deadline;       // Tick at which the current phase ends
+    uint32_t gap;            // Length of the silence after the current note (ticks)
+};
+
+_Static_assert(sizeof(AudioPlayer) <= ARENA_BUDGET_AUDIO, "AudioPlayer exceeds its arena budget");
+
+static bool channel_active(const Channel* channel) {
+    return channel->next < channel->count;
+}
+
+static void audio_stop_speaker(AudioPlayer* player) {
+    if(player->speaker_acquired) {
+        furi_hal_speaker_stop();
+    }
+}
+
+// Start the next note, sound effects first. Releases the speaker when done.
+static void audio_next_note(AudioPlayer* player) {
+    Channel* channel = NULL;
+    if(channel_active(&player->effect)) {
+        channel = &player->effect;
+    } else if(channel_active(&player->music)) {
+        channel = &player->music;
+    }
+    
+    // Nothing left to play
+    if(channel == NULL) {
+        if(player->speaker_acquired) {
+            furi_hal_speaker_stop();
+            furi_hal_speaker_release();
+            player->speaker_acquired = false;
+        }
+        player->phase = PhaseIdle;
+        return;
+    }
+    
+    // Acquire speaker before use, give up on all sounds if that fails
+    if(!player->speaker_acquired) {
+        if(!furi_hal_speaker_acquire(AUDIO_ACQUIRE_TIMEOUT_MS)) {
+            player->music.next = player->music.count;
+            player->effect.next = player->effect.count;
+            player->phase = PhaseIdle;
+            return;
+        }
+        player->speaker_acquired = true;
+    }
+    
+    const Note* note = &channel->notes[channel->next++];
+    uint32_t tone = furi_ms_to_ticks(note->duration * AUDIO_TONE_PERCENT / 100);
+    furi_hal_speaker_start(note->freq, AUDIO_VOLUME);
+    trace_record(TraceNote, channel == &player->music, (uint32_t)note->freq);
+    player->music_note = (channel == &player->music);
+    player->phase = PhaseTone;
+    player->deadline = furi_get_tick() + tone;
+    player->gap = furi_ms_to_ticks(note->duration) - tone;
+}
+
+// Handle a sound request
+static void audio_start_sound(AudioPlayer* player, AudioSound sound) {
+    const Sound* info = &sounds[sound];
+    
+    if(info->is_effect) {
+        // Replace a running effect and cut the current melody note short
+        player->effect = (Channel){info->notes, info->count, 0};
+        if(player->phase == PhaseTone && player->music_note) {
+            audio_stop_speaker(player);
+            player->phase = PhaseGap;
+        }
+        if(player->phase != PhaseTone) {
+            audio_next_note(player);
+        }
+    } else {
+        // If the melody is already playing, don't start it again
+        if(channel_active(&player->music) || (player->phase != PhaseIdle && player->music_note)) {
+            return;
+        }
+        player->music = (Channel){info->notes, info->count, 0};
+        if(player->phase == PhaseIdle) {
+            audio_next_note(player);
+        }
+    }
+}
+
+// Advance the sequencer when the current phase is over
+static void audio_update(AudioPlayer* player) {
+    if(player->phase == PhaseIdle || (int32_t)(furi_get_tick() - player->deadline) < 0) {
+        return;
+    }
+    if(player->phase == PhaseTone) {
+        audio_stop_speaker(player);
+        player->phase = PhaseGap;
+        player->deadline += player->gap;
+    } else {
+        audio_next_note(player);
+    }
+}
+
+// Worker thread: sleeps on the queue until the next request or note change
+static int32_t audio_worker(void* context) {
+    AudioPlayer* player = context;
+    
+    while(true) {
+        uint32_t timeout = FuriWaitForever;
+        if(player->phase != PhaseIdle) {
+            int32_t remaining = (int32_t)(player->deadline - furi_get_tick());
+            timeout = (remaining > 0) ? (uint32_t)remaining : 0;
+        }
+        
+        uint8_t command;
+        if(furi_message_queue_get(player->queue, &command, timeout) == FuriStatusOk) {
+            if(command == AUDIO_COMMAND_EXIT) {
+                break;
+            }
+            audio_start_sound(player, (AudioSound)command);
+        }
+        audio_update(player);
+    }
+    
+    // Release speaker before exit
+    if(player->speaker_acquired) {
+        furi_hal_speaker_stop();
+        furi_hal_speaker_release();
+        player->speaker_acquired = false;
+    }
+    return 0;
+}
+
+AudioPlayer* audio_player_alloc(void) {
+    AudioPlayer* player = arena_alloc(ArenaAudio, sizeof(AudioPlayer));
+    player->queue = furi_message_queue_alloc(AUDIO_QUEUE_SIZE, sizeof(uint8_t));
+    player->music = (Channel){NULL, 0, 0};
+    player->effect = (Channel){NULL, 0, 0};
+    player->phase = PhaseIdle;
+    player->music_note = false;
+    player->speaker_acquired = false;
+    player->deadline = 0;
+    player->gap = 0;
+    
+    player->thread = furi_thread_alloc();
+    furi_thread_set_name(player->thread, "PanisAudio");
+    furi_thread_set_stack_size(player->thread, AUDIO_STACK_SIZE);
+    furi_thread_set_context(player->thread, player);
+    furi_thread_set_callback(player->thread, audio_worker);
+    furi_thread_start(player->thread);
+    return player;
+}
+
+void audio_player_free(AudioPlayer* player) {
+    uint8_t command = AUDIO_COMMAND_EXIT;
+    furi_message_queue_put(player->queue, &command, FuriWaitForever);
+    furi_thread_join(player->thread);
+    furi_thread_free(player->thread);
+    furi_message_queue_free(player->queue);
+    arena_reset(ArenaAudio);
+}
+
+void audio_player_play(AudioPlayer* player, AudioSound sound) {
+    furi_assert(sound < AudioSoundCount);
+    uint8_t command = sound;
+    furi_message_queue_put(player->queue, &command, 0);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <furi.h>
+
+// Sounds the audio player knows
+typedef enum {
+    AudioSoundMelody,   // Background melody 'Little things'
+    AudioSoundPill,     // Pill collected
+    AudioSoundDiamond,  // Diamond activated
+    AudioSoundBump,     // Bumped into a block
+    AudioSoundCount,
+} AudioSound;
+
+typedef struct AudioPlayer AudioPlayer;
+
+// Start the audio worker thread
+AudioPlayer* audio_player_alloc(void);
+
+// Stop any sound, then stop and free the audio worker
+void audio_player_free(AudioPlayer* player);
+
+// Queue a sound. Never blocks, the request is dropped when the queue is full.
+// Sound effects interrupt the melody, which continues after them.
+void audio_player_play(AudioPlayer* player, AudioSound sound);
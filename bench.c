@@ -0,0 +1,147 @@
+#include "bench.h"
+
+#ifdef PANIS_PROFILER
+
+#include <input/input.h>
+#include <toolbox/version.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "profiler.h"
+
+#define TAG "PanisBench"
+
+#define BENCH_TOASTERS 8       // Toasters per chunk, fills the entity pool
+#define BENCH_JUMP_STEPS 40    // Steps between two jumps, a small jump takes 39
+#define BENCH_SCRIPT_STEPS (BENCH_FRAMES * 2)  // Covers the run even if frames are slow
+#define BENCH_SCRIPT_SIZE (BENCH_SCRIPT_STEPS / BENCH_JUMP_STEPS + 3)
+
+// One chunk, repeated along the level. Row 5 stays free for walking, the
+// toasters stand there too.
+static const char bench_chunk[GRID_ROWS][CHUNK_COLS + 1] = {
+    "~D~D~D~D",
+    "d~d~d~d~",
+    "#o#.#o#.",
+    ".#o#d#o#",
+    "o.o.o.o.",
+    "........",
+};
+
+static InputRecord script[BENCH_SCRIPT_SIZE];
+
+static bool read_bench_chunk(void* context, uint16_t index, uint8_t* cells) {
+    UNUSED(context);
+    UNUSED(index);
+    for(int row = 0; row < GRID_ROWS; row++) {
+        for(int col = 0; col < CHUNK_COLS; col++) {
+            uint8_t cell;
+            switch(bench_chunk[row][col]) {
+            case '#':
+                cell = CELL_BLOCK;
+                break;
+            case 'o':
+                cell = CELL_PILL;
+                break;
+            case 'd':
+                cell = CELL_DIAMOND;
+                break;
+            case 'D':
+                cell = CELL_DIAMOND_FILLED;
+                break;
+            case '~':
+                cell = CELL_CLOUD;
+                break;
+            default:
+                cell = CELL_EMPTY;
+                break;
+            }
+            cells[row * CHUNK_COLS + col] = cell;
+        }
+    }
+    return true;
+}
+
+void bench_get_level(GameLevel* level) {
+    memset(level, 0, sizeof(GameLevel));
+    level->num_chunks = MAX_LEVEL_CHUNKS;
+    level->read_chunk = read_bench_chunk;
+    level->toasters_per_chunk = BENCH_TOASTERS;
+}
+
+const InputRecord* bench_get_script(size_t* count) {
+    size_t size = 0;
+    
+    // Hold down for the grid overlay and right for walking all the way
+    script[size++] = (InputRecord){0, InputKeyDown, INPUT_LOG_HELD | InputTypePress};
+    script[size++] = (InputRecord){0, InputKeyRight, INPUT_LOG_HELD | InputTypePress};
+    for(uint32_t step = BENCH_JUMP_STEPS; step < BENCH_SCRIPT_STEPS; step += BENCH_JUMP_STEPS) {
+        script[size++] = (InputRecord){step, InputKeyUp, InputTypePress};
+    }
+    script[size++] = (InputRecord){BENCH_SCRIPT_STEPS, INPUT_LOG_END, 0};
+    furi_assert(size <= BENCH_SCRIPT_SIZE);
+    *count = size;
+    return script;
+}
+
+// Write a formatted line, false on errors
+static bool write_line(File* file, const char* format, ...) {
+    char line[96];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(length < 0 || (size_t)length >= sizeof(line)) {
+        return false;
+    }
+    return storage_file_write(file, line, length) == (size_t)length;
+}
+
+bool bench_write_results(
+    Storage* storage,
+    const char* path,
+    uint32_t frames,
+    uint32_t elapsed_ms,
+    size_t heap_free_min) {
+    File* file = storage_file_alloc(storage);
+    bool written = storage_file_open(file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS) &&
+                   write_line(file, "stage,samples,p50_us,p90_us,p99_us,max_us\n");
+    for(int stage = 0; stage < ProfileStageCount && written; stage++) {
+        ProfileSummary summary;
+        profiler_summarize(stage, &summary);
+        written = write_line(
+            file,
+            "%s,%lu,%lu,%lu,%lu,%lu\n",
+            profiler_stage_name(stage),
+            (unsigned long)summary.samples,
+            (unsigned long)summary.p50,
+            (unsigned long)summary.p90,
+            (unsigned long)summary.p99,
+            (unsigned long)summary.max);
+    }
+    
+    // Run and build information
+    written = written && write_line(file, "\nname,value\n") &&
+              write_line(file, "frames,%lu\n", (unsigned long)frames) &&
+              write_line(file, "elapsed_ms,%lu\n", (unsigned long)elapsed_ms) &&
+              write_line(
+                  file,
+                  "fps,%lu\n",
+                  (unsigned long)(elapsed_ms > 0 ? (uint64_t)frames * 1000 / elapsed_ms : 0)) &&
+              write_line(file, "heap_free_min,%lu\n", (unsigned long)heap_free_min) &&
+              write_line(
+                  file, "heap_free_min_ever,%lu\n", (unsigned long)memmgr_get_minimum_free_heap()) &&
+              write_line(file, "firmware,%s\n", version_get_version(NULL)) &&
+              write_line(file, "firmware_commit,%s\n", version_get_githash(NULL));
+    storage_file_close(file);
+    storage_file_free(file);
+    
+    if(written) {
+        FURI_LOG_I(TAG, "Results written to %s", path);
+    } else {
+        FURI_LOG_W(TAG, "Can't write %s", path);
+    }
+    return written;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include "game.h"
+#include "input_log.h"
+
+// Stress benchmark, launched with the argument "bench" in builds with the
+// PANIS_PROFILER define: a worst-case level played by a scripted session
+// for BENCH_FRAMES frames, the profiler timings are written as CSV.
+
+#ifdef PANIS_PROFILER
+
+#define BENCH_PATH APP_DATA_PATH("bench.csv")
+#define BENCH_FRAMES 1200  // 30 seconds at the full frame rate
+#define BENCH_SEED 0x50414E49  // Fixed, so every run places the same toasters
+
+// Dense level of MAX_LEVEL_CHUNKS chunks: clouds, diamonds, blocks and pills
+// everywhere Panis can reach, and the entity pool full of toasters
+void bench_get_level(GameLevel* level);
+
+// Scripted input: walking right with the grid overlay shown, jumping again
+// right after every landing. Records are valid until the app exits.
+const InputRecord* bench_get_script(size_t* count);
+
+// Write the stage timing percentiles and heap minimums
+bool bench_write_results(
+    Storage* storage,
+    const char* path,
+    uint32_t frames,
+    uint32_t elapsed_ms,
+    size_t heap_free_min);
+
+#endif
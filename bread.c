@@ -1,389 +1,577 @@
 #include <furi.h>
 #include <furi_hal.h>
 #include <gui/gui.h>
+#include <toolbox/compress.h>
 #include <input/input.h>
 #include <notification/notification_messages.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
 
 // Include generated icon assets
 #include "panis_icons.h"
+#include "game.h"
+#include "audio.h"
+#include "level_file.h"
+#include "input_log.h"
+#include "resume_file.h"
+#include "prefetch.h"
+#include "asset_cache.h"
+#include "arena.h"
+#include "trace.h"
+#include "bench.h"
+#include "builtin_level.h"
+#include "profiler.h"
 
-// Screen dimensions for Flipper Zero
-#define SCREEN_WIDTH 128
-#define SCREEN_HEIGHT 64
-
-// PANIS configuration
-#define MOVEMENT_SPEED 4  // Pixels per frame
-#define GROUND_Y 59  // Y position of the ground line
-
-// Jump physics
-#define GRAVITY 2
-#define SMALL_JUMP_VELOCITY -10
-#define BIG_JUMP_VELOCITY -20
-#define MAX_FALL_SPEED 10
-#define MAX_JUMP_HEIGHT 60  // Maximum pixels above ground
-#define JUMP_HEIGHT_THRESHOLD 25  // Height to distinguish small/big jump
-#define DOUBLE_CLICK_MS 900  // Time window for double-click (milliseconds)
-
-// Map tile configuration
-#define TILE_WIDTH 128
-#define NUM_TILES 3  // map_tile_0, map_tile_1, map_tile_2
-#define TOTAL_MAP_WIDTH (TILE_WIDTH * NUM_TILES)
-
-// Character dimensions
-#define CHAR_WIDTH 10
-#define CHAR_HEIGHT 10
-
-// Scrolling thresholds
-#define START_SCROLL_X (SCREEN_WIDTH / 2)  // Start scrolling at 1/2 screen (64px)
-#define CHAR_START_X (SCREEN_WIDTH / 4)    // Character starts at 1/4 screen (32px)
-
-// Grid configuration
-#define CELL_SIZE 10
-#define GRID_ROWS 6
-#define GRID_COLS 39  // (128*3)/10 = 38.4, so 39 columns
-#define CELL_EMPTY 0
-#define CELL_BLOCK 1
-#define CELL_PILL 2
-#define CELL_DIAMOND 3
-#define CELL_DIAMOND_FILLED 4
-#define CELL_CLOUD 5
-
-// Grid generation percentages (as decimals)
-#define SKY_ROW_THRESHOLD 2         // Rows 0-1 are "sky" rows
-#define PERCENT_PILLS 0.02          // 2% pills
-#define PERCENT_AIR_BLOCKS 0.005    // 0.5% random air blocks
-#define PERCENT_GROUND_BLOCKS 0.02  // ~2% ground/stacked blocks
-#define PERCENT_CLOUDS 0.15         // 15% clouds in sky rows
+#define TAG "Panis"
 
-// Game state structure
+// Frame pacing
+#define FRAME_RATE_HZ 40     // Frame timer rate: input handling and redraws
+#define PHYSICS_STEP_MS (GAME_STEP_MS / GAME_SUBSTEPS)  // Fixed physics timestep, 40 Hz
+#define MAX_PHYSICS_STEPS (5 * GAME_SUBSTEPS)  // Upper bound of physics steps per frame (half a second)
+#define FRAME_FLAG_TICK (1UL << 0)  // Thread flag set by the frame timer
+#define FRAME_FLAG_INPUT (1UL << 1)  // Thread flag set by the input callback
+#define IDLE_FRAMES 20  // Idle frames before the loop sleeps until the next input
+#define SPLASH_MS 1500  // Title art shown on the first launch, a key press skips it
+
+// Input handling
+#define INPUT_QUEUE_SIZE 16  // Pending input events, extra events are dropped
+#define KEY_BIT(key) (1UL << (key))
+#define MOVE_KEYS (KEY_BIT(InputKeyLeft) | KEY_BIT(InputKeyRight))
+
+// Feedback rate limiting: every effect is dispatched at most once per
+// cooldown, requests in between are coalesced into one dispatch at its end
+#define FEEDBACK_PILL_COOLDOWN_MS 100     // About the length of the pill sound
+#define FEEDBACK_DIAMOND_COOLDOWN_MS 160  // About the length of the diamond sound
+#define FEEDBACK_BUMP_COOLDOWN_MS 300     // Vibration while pushing against a block
+
+// Static layer cache configuration: background tiles, clouds and blocks are
+// pre-composited into vertical strips of the level
+#define STRIP_WIDTH 40  // Pixels per strip, multiple of 8 and of CELL_SIZE
+#define STRIP_COLS (STRIP_WIDTH / CELL_SIZE)
+#define STRIP_STRIDE (STRIP_WIDTH / 8)  // Bytes per strip row
+#define STRIP_SLOTS ((SCREEN_WIDTH + STRIP_WIDTH - 1) / STRIP_WIDTH + 1)  // Strips on screen at most
+#define ICON_DECODE_BUF_SIZE (TILE_WIDTH * TILE_HEIGHT / 8)
+#define STRIPS_PER_CHUNK (CHUNK_WIDTH / STRIP_WIDTH)
+
+// Render snapshot configuration
+#define VIEW_COLS (STRIP_SLOTS * STRIP_COLS)  // Columns of all strips on screen
+#define VIEW_TILES ((VIEW_COLS * CELL_SIZE + TILE_WIDTH - 1) / TILE_WIDTH + 1)  // Tiles they overlap
+#define VIEW_ENTITIES MAX_ENTITIES  // Entities on screen at most
+#define SNAPSHOT_SLOT_MASK 0x03  // Slot index bits of RenderBuffer.spare
+#define SNAPSHOT_FRESH 0x04      // Set in RenderBuffer.spare when a new frame is waiting
+
+// Everything the draw callback needs for one frame
 typedef struct {
-    int world_x;           // Character's X position in the world (0 to TOTAL_MAP_WIDTH)
+    const AssetImage* splash;  // Title art drawn instead of the level, NULL while playing
+    int camera_x;          // Camera offset
     int screen_x;          // Character's X position on screen
-    int camera_x;          // Camera offset (how much the world is scrolled)
-    bool facing_right;     // True if facing right, false if facing left
+    int y_pos;             // Character Y position
+    bool facing_right;     // Character orientation
+    bool grid_view_enabled; // Grid overlay visible
+#ifdef PANIS_PROFILER
+    bool profiler_enabled;  // Frame timings shown instead of the level
+#endif
+    int first_col;         // World column of cells[][0], first column of a strip
+    int num_cols;          // Number of valid columns in cells
+    uint8_t cells[GRID_ROWS][VIEW_COLS];  // Visible part of the grid
+    uint16_t strip_version[STRIP_SLOTS];  // Static content version of each visible strip
+    int map_width;         // Width of the level in pixels
+    int first_tile;        // Background tile of tiles[0]
+    uint8_t tiles[VIEW_TILES];  // Background images of the tiles behind the strips
+    int num_entities;      // Visible entities
+    int16_t entity_x[VIEW_ENTITIES];  // Screen position of the top left corner
+    int16_t entity_y[VIEW_ENTITIES];
+    uint8_t entity_type[VIEW_ENTITIES];  // EntityType
+    bool entity_right[VIEW_ENTITIES];  // Moving right
+    int pill_count;        // Counters for the stats line
+    int block_count;
+    int ground_blocks;
+    int overall_pills;
+    int overall_diamonds;
+    int filled_diamonds;
+} RenderSnapshot;
+
+// Lock-free triple buffer between game loop and draw callback. The game loop
+// fills the back slot and publishes it by swapping it with the spare slot, the
+// draw callback swaps its front slot with the spare slot when a fresh frame is
+// waiting. Neither side ever waits, and a slot is never written while read.
+typedef struct {
+    RenderSnapshot slots[3];
+    uint8_t back;          // Slot written by the game loop (app thread only)
+    uint8_t front;         // Slot read by the draw callback (GUI thread only)
+    atomic_uint_fast8_t spare;  // Slot in between, plus SNAPSHOT_FRESH flag
+} RenderBuffer;
+
+// HUD text cache configuration
+#define HUD_TEXT_SIZE 16
+#define LABEL_EVERY_COLS 5   // Grid overlay labels every 5th column
+#define LABEL_CACHE_SLOTS 4  // More than the labels visible at once
+
+// Formatted stats line and grid labels, rebuilt only when their values change.
+// Only used by the draw callback (GUI thread).
+typedef struct {
+    bool valid;            // False until the first frame was formatted
+    int pill_count;        // Counters the strings were formatted from
+    int block_count;
+    int ground_blocks;
+    int overall_pills;
+    int overall_diamonds;
+    int filled_diamonds;
+    char blocks_str[HUD_TEXT_SIZE];    // "B:[ground]([total])"
+    char diamonds_str[HUD_TEXT_SIZE];  // "D:[filled]([overall])"
+    char pills_str[HUD_TEXT_SIZE];     // "P:[collected]([overall])"
+    int diamonds_x;        // Screen X of the centered diamond counter
+    int pills_x;           // Screen X of the right aligned pill counter
+    int label_col[LABEL_CACHE_SLOTS];  // Column of each cached label, -1 if unused
+    char label_str[LABEL_CACHE_SLOTS][8];
+} HudCache;
+
+// Pre-composited static layer strips (GUI thread only). Strip `n` is cached
+// in slot `n % STRIP_SLOTS`, so all strips on screen fit at the same time.
+typedef struct {
+    int strip[STRIP_SLOTS];        // Strip held by each slot, -1 if empty
+    uint16_t version[STRIP_SLOTS]; // Static content version the slot was built from
+    uint8_t bits[STRIP_SLOTS][TILE_HEIGHT * STRIP_STRIDE];  // XBM image of each slot
+    uint8_t cloud[CELL_SIZE * 2];  // Decoded cloud icon, 2 bytes per row
+    CompressIcon* decoder;         // Unpacks the compiled-in icons
+} LayerCache;
+
+// How a cell type is drawn: static cells are composited into the layer
+// cache, dynamic ones are drawn over it every frame
+typedef enum {
+    CellSpriteNone,
+    CellSpriteBlock,  // Static: solid box
+    CellSpriteCloud,  // Static: the cloud icon, blended in
+    CellSpriteDisc,   // Dynamic: small filled circle
+    CellSpriteIcon,   // Dynamic: `icon`
+} CellSpriteKind;
+
+typedef struct {
+    uint8_t kind;  // CellSpriteKind
+    const Icon* icon;
+} CellSprite;
+
+// Sprite of each cell type, the rendering part of game_cell_behavior
+static const CellSprite cell_sprites[CELL_TYPES] = {
+    [CELL_EMPTY] = {CellSpriteNone, NULL},
+    [CELL_BLOCK] = {CellSpriteBlock, NULL},
+    [CELL_PILL] = {CellSpriteDisc, NULL},
+    [CELL_DIAMOND] = {CellSpriteIcon, &I_diamond_empty},
+    [CELL_DIAMOND_FILLED] = {CellSpriteIcon, &I_diamond_full},
+    [CELL_CLOUD] = {CellSpriteCloud, NULL},
+};
+
+// Sound and vibration feedback of game events
+typedef enum {
+    FeedbackPill,
+    FeedbackDiamond,
+    FeedbackBump,
+    FeedbackCount,
+} Feedback;
+
+// Pending feedback and when each effect was last dispatched
+typedef struct {
+    uint32_t pending;  // Bit per Feedback requested since its last dispatch
+    uint32_t last_dispatch[FeedbackCount];  // Tick of the last dispatch
+} FeedbackScheduler;
+
+// Game state structure
+typedef struct {
+    Game game;             // Level, character and counters
     bool running;          // Game loop control
-    int y_pos;             // Character Y position (0 = top)
-    int y_velocity;        // Vertical velocity
-    bool on_ground;        // True if character is on ground
-    uint32_t last_jump_time;  // Time of last jump press
     NotificationApp* notifications;  // For vibration feedback
-    uint8_t grid[GRID_ROWS][GRID_COLS];  // Collision grid
-    int score;             // Collected pills score
-    int block_count;       // Number of blocks in grid
-    int pill_count;        // Number of pills remaining
-    int overall_pills;     // Total pills placed
-    int overall_diamonds;  // Total diamonds placed
-    int filled_diamonds;   // Number of filled diamonds
-    int ground_blocks;     // Number of blocks on/near ground
+    LevelFile* level_file; // Level loaded from SD card, NULL for other levels
     bool grid_view_enabled; // True when down button is held
-	FuriThread* melody_thread; // Thread for playing melody
+#ifdef PANIS_PROFILER
+    bool profiler_enabled;  // Toggled with OK while down is held
+#endif
+    AudioPlayer* audio;    // Plays the melody and sound effects
+    ChunkPrefetcher* prefetcher;  // Prepares the next chunk of the level ahead
+    AssetCache* assets;    // Large images read from the SD card when needed
+    const AssetImage* splash;  // Title art shown before the level starts, else NULL
+    FeedbackScheduler feedback;  // Rate limits sound effects and vibration
+    FuriMessageQueue* input_queue;  // Key events from the input service
+    FuriThreadId loop_thread;  // Game loop, woken by the input callback while idle
+    Storage* storage;      // Open for the whole session
+    atomic_uint_least32_t held_keys;  // Bitmask of held keys, written by the input callback
+    uint32_t keys;         // Held keys the game sees, sampled once per frame or replayed
+    uint32_t moved_keys;   // Movement keys already applied since the last physics step
+    uint32_t steps;        // Physics steps done, the time base of recordings
+    InputLog* recorder;    // Records the input of this session, NULL if not recording
+    InputLog* replay;      // Recording played back instead of live input, NULL if live
+    bool dirty;            // True when something on screen changed since the last redraw
+    RenderBuffer render;   // Snapshots handed over to the draw callback
+    uint8_t view_cells[GRID_ROWS][VIEW_COLS];  // Cells of the last snapshot, patched from the cell journal
+    int view_first_col;    // World column of view_cells[][0]
+    int view_num_cols;     // Columns of view_cells in use
+    HudCache hud;          // Cached HUD strings (draw callback only)
+    LayerCache layer;      // Cached static layer (draw callback only)
 } GameState;
 
-// Helper function for vibration feedback
-static void trigger_vibration(GameState* state) {
-    notification_message(state->notifications, &sequence_single_vibro);
-}
+// Background images, repeated along the level
+static const Icon* const map_tiles[] = {
+    &I_map_tile_0,
+    &I_map_tile_1,
+    &I_map_tile_2,
+};
 
+_Static_assert(CHUNK_WIDTH % STRIP_WIDTH == 0, "Strips must not cross chunk boundaries");
+_Static_assert(
+    sizeof(GameState) + sizeof(GameProgress) + 2 * ARENA_ALIGN <= ARENA_BUDGET_GAME,
+    "GameState exceeds its arena budget");
 
+// What each feedback does and how often
+typedef struct {
+    AudioSound sound;
+    bool vibrate;
+    uint16_t cooldown_ms;
+} FeedbackEffect;
+
+static const FeedbackEffect feedback_effects[FeedbackCount] = {
+    [FeedbackPill] = {AudioSoundPill, false, FEEDBACK_PILL_COOLDOWN_MS},
+    [FeedbackDiamond] = {AudioSoundDiamond, false, FEEDBACK_DIAMOND_COOLDOWN_MS},
+    [FeedbackBump] = {AudioSoundBump, true, FEEDBACK_BUMP_COOLDOWN_MS},
+};
 
-// Helper function for melody 'Little things'
-void play_melody(void) {
-    // Melody: frequency (Hz), duration (ms)
-    typedef struct {
-        float freq;
-        uint32_t duration;
-    } Note;
-	// Acquire speaker before use
-    if(!furi_hal_speaker_acquire(1000)) { // Failed to acquire speaker, exit      
-       return;
+// Make every effect available right away
+static void feedback_init(FeedbackScheduler* feedback, uint32_t now) {
+    feedback->pending = 0;
+    for(int i = 0; i < FeedbackCount; i++) {
+        feedback->last_dispatch[i] = now - furi_ms_to_ticks(feedback_effects[i].cooldown_ms);
     }
-    
-    Note melody[] = {
-        // Measure 1: E4, C5, E5, C5, E5
-        {329.63f, 454},  // E4 quarter
-        {523.25f, 227},  // C5 eighth
-        {659.25f, 227},  // E5 eighth
-        {523.25f, 227},  // C5 eighth
-        {659.25f, 227},  // E5 eighth
-        
-        // Measure 2: B4 (dotted half)
-        {493.88f, 1364}, // B4 dotted half
-        
-        // Measure 3: B4, C5, E5, C5, E5
-        {493.88f, 454},  // B4 quarter
-        {523.25f, 227},  // C5 eighth
-        {659.25f, 227},  // E5 eighth
-        {523.25f, 227},  // C5 eighth
-        {659.25f, 227},  // E5 eighth
-        
-        // Measure 4: B4 (dotted half)
-        {493.88f, 1364}  // B4 dotted half
-    };
-  
-    for(size_t i = 0; i < COUNT_OF(melody); i++) {
-        furi_hal_speaker_start(melody[i].freq, 1.0f);
-        furi_delay_ms(melody[i].duration * 0.9);
-        
-        furi_hal_speaker_stop();
-        furi_delay_ms(melody[i].duration * 0.1);
+}
+
+// Dispatch the pending effects whose cooldown has passed, the others stay
+// pending. An effect requested many times in one cooldown costs a single
+// sound request and notification message.
+static void feedback_dispatch(GameState* state, uint32_t now) {
+    FeedbackScheduler* feedback = &state->feedback;
+    for(int i = 0; i < FeedbackCount; i++) {
+        const FeedbackEffect* effect = &feedback_effects[i];
+        if(!(feedback->pending & (1UL << i)) ||
+           now - feedback->last_dispatch[i] < furi_ms_to_ticks(effect->cooldown_ms)) {
+            continue;
+        }
+        feedback->pending &= ~(1UL << i);
+        feedback->last_dispatch[i] = now;
+        trace_record(TraceFeedback, i, 0);
+        audio_player_play(state->audio, effect->sound);
+        if(effect->vibrate) {
+            notification_message(state->notifications, &sequence_single_vibro);
+        }
+    }
+}
+
+// Turn the events of the game core into redraws, sounds and vibration
+static void handle_game_events(GameState* state) {
+    uint32_t events = game_take_events(&state->game);
+    if(events & GameEventChanged) {
+        state->dirty = true;
+    }
+    if(events & (GameEventPill | GameEventDiamond)) {
+        trace_record(TraceCollect, events, state->game.score);
     }
+    if(events & GameEventPill) {
+        state->feedback.pending |= 1UL << FeedbackPill;
+    }
+    if(events & GameEventDiamond) {
+        state->feedback.pending |= 1UL << FeedbackDiamond;
+    }
+    if(events & GameEventBump) {
+        state->feedback.pending |= 1UL << FeedbackBump;
+    }
+    if(state->feedback.pending) {
+        feedback_dispatch(state, furi_get_tick());
+    }
+}
+
+// Read a chunk of the level file, for GameLevel.read_chunk
+static bool read_level_file_chunk(void* context, uint16_t index, uint8_t* cells) {
+    return level_file_read_chunk(context, index, cells);
+}
+
+// Calculate the range of static layer strips (inclusive) visible for a camera offset
+static void get_visible_strips(int camera_x, int map_width, int* first_strip, int* last_strip) {
+    int num_strips = (map_width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+    *first_strip = camera_x / STRIP_WIDTH;
+    *last_strip = (camera_x + SCREEN_WIDTH - 1) / STRIP_WIDTH;
     
-    furi_hal_speaker_stop();
-    furi_hal_speaker_release();
+    // Clamp to map boundaries
+    if(*first_strip < 0) *first_strip = 0;
+    if(*last_strip >= num_strips) *last_strip = num_strips - 1;
 }
 
-// Thread function to play melody without blocking
-static int32_t melody_thread(void* context) {
-    UNUSED(context);
-    play_melody();
-    return 0;
+// Add an entity to the snapshot if it is on screen, game_for_each_entity callback
+static void snapshot_entity(void* context, const Entities* entities, uint8_t entity) {
+    RenderSnapshot* frame = context;
+    int x = entities->x[entity] - frame->camera_x;
+    if(x <= -CELL_SIZE || x >= SCREEN_WIDTH || frame->num_entities >= VIEW_ENTITIES) {
+        return;
+    }
+    int i = frame->num_entities++;
+    frame->entity_x[i] = x;
+    frame->entity_y[i] = entities->y[entity];
+    frame->entity_type[i] = entities->type[entity];
+    frame->entity_right[i] = entities->vx[entity] > 0;
 }
 
-// Helper function to start melody in background thread, and clean up automatically
-static void play_melody_async(GameState* state) {
-    // If a melody is already playing, don't start another
-    if(state->melody_thread != NULL) {
-        if(furi_thread_get_state(state->melody_thread) != FuriThreadStateStopped) {
-            return; // Thread still running
+// Bring the visible cells up to date: only the journaled changes while the
+// view stays on the same columns, all cells after scrolling to other strips
+// or when the journal can't tell what changed
+static void update_view_cells(GameState* state, int first_col, int num_cols) {
+    CellJournal journal;
+    game_take_changes(&state->game, &journal);
+    if(journal.rescan || first_col != state->view_first_col || num_cols != state->view_num_cols) {
+        for(int row = 0; row < GRID_ROWS; row++) {
+            for(int c = 0; c < num_cols; c++) {
+                state->view_cells[row][c] = game_get_cell(&state->game, row, first_col + c);
+            }
         }
-        // Clean up old thread
-        furi_thread_free(state->melody_thread);
-        state->melody_thread = NULL;
-    }
-    // Create and start new thread
-    state->melody_thread = furi_thread_alloc();
-    furi_thread_set_name(state->melody_thread, "MelodyThread");
-    furi_thread_set_stack_size(state->melody_thread, 2048);
-    furi_thread_set_callback(state->melody_thread, melody_thread);
-    furi_thread_start(state->melody_thread);
-}
-
-// Initialize the collision grid
-static void init_grid(GameState* state) {
-    // Clear grid
-    for(int row = 0; row < GRID_ROWS; row++) {
-        for(int col = 0; col < GRID_COLS; col++) {
-            state->grid[row][col] = CELL_EMPTY;
+        state->view_first_col = first_col;
+        state->view_num_cols = num_cols;
+        return;
+    }
+    for(int i = 0; i < journal.count; i++) {
+        const CellChange* change = &journal.changes[i];
+        int c = change->col - first_col;
+        if(c >= 0 && c < num_cols) {
+            state->view_cells[change->row][c] = change->cell;
         }
     }
+}
+
+// Copy the render-relevant part of the game state into a snapshot
+static void snapshot_game_state(GameState* state, RenderSnapshot* frame) {
+    const Game* game = &state->game;
+    frame->splash = state->splash;
+    frame->camera_x = game->camera_x;
+    frame->screen_x = game->screen_x;
+    frame->y_pos = game->y_pos;
+    frame->facing_right = game->facing_right;
+    frame->grid_view_enabled = state->grid_view_enabled;
+#ifdef PANIS_PROFILER
+    frame->profiler_enabled = state->profiler_enabled;
+#endif
     
-    int total_cells = GRID_ROWS * GRID_COLS;
-    int num_pills = (int)(total_cells * PERCENT_PILLS);
-    int num_air_blocks = (int)(total_cells * PERCENT_AIR_BLOCKS);
-    int num_ground_blocks = (int)(total_cells * PERCENT_GROUND_BLOCKS);
-    
-    state->score = 0;
-    state->block_count = 0;
-    state->pill_count = 0;
-    state->overall_pills = 0;
-    state->overall_diamonds = 0;
-    state->filled_diamonds = 0;
-    state->ground_blocks = 0;   
-
-    // Place clouds in sky rows only (rows 0-1)
-    int sky_cells = SKY_ROW_THRESHOLD * GRID_COLS;
-    int num_clouds = (int)(sky_cells * PERCENT_CLOUDS);
-    
-    int clouds_placed = 0;
-    int cloud_attempts = 0;
-    while(clouds_placed < num_clouds && cloud_attempts < sky_cells * 2) {
-        int row = rand() % SKY_ROW_THRESHOLD;  // Only rows 0-1
-        int col = rand() % GRID_COLS;
-        if(state->grid[row][col] == CELL_EMPTY) {
-            state->grid[row][col] = CELL_CLOUD;
-            clouds_placed++;
-        }
-        cloud_attempts++;
-    }	
-    
-    // Place air blocks (random positions in rows 0-4)
-    for(int i = 0; i < num_air_blocks; i++) {
-        int row = rand() % 5;  // Rows 0-4 (not on ground)
-        int col = rand() % GRID_COLS;
-        if(state->grid[row][col] == CELL_EMPTY) {
-            state->grid[row][col] = CELL_BLOCK;
-            state->block_count++;
-        }
+    // Copy the columns of all visible strips
+    int first_strip, last_strip;
+    get_visible_strips(game->camera_x, game->map_width, &first_strip, &last_strip);
+    int first_col = first_strip * STRIP_COLS;
+    int end_col = (last_strip + 1) * STRIP_COLS;
+    if(end_col > game->level_cols) end_col = game->level_cols;
+    frame->first_col = first_col;
+    frame->num_cols = end_col - first_col;
+    update_view_cells(state, first_col, frame->num_cols);
+    memcpy(frame->cells, state->view_cells, sizeof(frame->cells));
+    for(int strip = first_strip; strip <= last_strip; strip++) {
+        frame->strip_version[strip - first_strip] = game->chunk_version[strip / STRIPS_PER_CHUNK];
     }
     
-    // Place ground blocks (on row 5 or stacked)
-    for(int i = 0; i < num_ground_blocks; i++) {
-        int col = rand() % GRID_COLS;
-        // Find lowest empty cell in this column
-        for(int row = GRID_ROWS - 1; row >= 0; row--) {
-            if(state->grid[row][col] == CELL_EMPTY) {
-                state->grid[row][col] = CELL_BLOCK;
-                state->block_count++;
-				state->ground_blocks++;
-                break;
-            }
-        }
+    // Background tiles behind the strips
+    frame->map_width = game->map_width;
+    frame->first_tile = first_col * CELL_SIZE / TILE_WIDTH;
+    for(int i = 0; i < VIEW_TILES; i++) {
+        int tile = MIN(frame->first_tile + i, MAX_LEVEL_TILES - 1);
+        frame->tiles[i] = game->tiles[tile] % COUNT_OF(map_tiles);
     }
     
-    // Place pills in empty cells
-    int pills_placed = 0;
-    int attempts = 0;
-    while(pills_placed < num_pills && attempts < total_cells * 2) {
-        int row = rand() % GRID_ROWS;
-        int col = rand() % GRID_COLS;
-        if(state->grid[row][col] == CELL_EMPTY) {
-            state->grid[row][col] = CELL_PILL;
-            state->pill_count++;
-			state->overall_pills++;
-            pills_placed++;
-        }
-        attempts++;
+    // Entities of the visible columns
+    frame->num_entities = 0;
+    if(frame->num_cols > 0) {
+        game_for_each_entity(game, first_col, end_col - 1, snapshot_entity, frame);
     }
-	
-	// Create bridge: columns 13-17, rows 3 (two above ground)
-	// First clear any blocks underneath the bridge
-	for(int col = 13; col <= 17; col++) {
-		for(int row = 4; row <= 5; row++) {
-			if(state->grid[row][col] == CELL_BLOCK) {
-				state->block_count--;
-				state->ground_blocks--;
-			}
-			state->grid[row][col] = CELL_EMPTY;
- 		}
-	}
-	// Place bridge blocks
-	for(int col = 13; col <= 17; col++) {
-		state->grid[3][col] = CELL_BLOCK;
-		state->block_count += 2;
-		// Place diamonds on top of bridge
-		state->grid[2][col] = CELL_DIAMOND_FILLED;
-		state->overall_diamonds++;
-	}
-	
-	 // Place diamonds below pills in sky rows (0-1)
-    for(int row = 0; row < SKY_ROW_THRESHOLD; row++) {
-        for(int col = 0; col < GRID_COLS; col++) {
-            if(state->grid[row][col] == CELL_PILL) {
-                // Place diamond in cell below if empty
-                int below_row = row + 1;
-                if(below_row < GRID_ROWS && state->grid[below_row][col] == CELL_EMPTY) {
-                    state->grid[below_row][col] = CELL_DIAMOND_FILLED;
-					state->overall_diamonds++;
-                }
-            }
-        }
+    
+    frame->pill_count = game->pill_count;
+    frame->block_count = game->block_count;
+    frame->ground_blocks = game->ground_blocks;
+    frame->overall_pills = game->overall_pills;
+    frame->overall_diamonds = game->overall_diamonds;
+    frame->filled_diamonds = game->filled_diamonds;
+}
+
+// Set up the slot roles of the render buffer
+static void render_init(RenderBuffer* render) {
+    render->back = 0;
+    render->front = 1;
+    atomic_init(&render->spare, 2);
+}
+
+// Snapshot the game state and hand it over to the draw callback (app thread)
+static void render_publish(GameState* state) {
+    RenderBuffer* render = &state->render;
+    snapshot_game_state(state, &render->slots[render->back]);
+    uint_fast8_t old = atomic_exchange(&render->spare, render->back | SNAPSHOT_FRESH);
+    render->back = old & SNAPSHOT_SLOT_MASK;
+}
+
+// Get the newest published snapshot (GUI thread)
+static const RenderSnapshot* render_acquire(RenderBuffer* render) {
+    if(atomic_load(&render->spare) & SNAPSHOT_FRESH) {
+        uint_fast8_t old = atomic_exchange(&render->spare, render->front);
+        render->front = old & SNAPSHOT_SLOT_MASK;
     }
+    return &render->slots[render->front];
 }
 
-// Get grid cell at world position
-static uint8_t get_cell_at(GameState* state, int world_x, int world_y) {
-    int col = world_x / CELL_SIZE;
-    int row = world_y / CELL_SIZE;
-    
-    if(row < 0 || row >= GRID_ROWS || col < 0 || col >= GRID_COLS) {
-        return CELL_EMPTY;
+// Get the background image of a map tile
+static const Icon* get_tile_icon(const RenderSnapshot* frame, int tile) {
+    return map_tiles[frame->tiles[tile - frame->first_tile]];
+}
+
+// Set up an empty static layer cache
+static void layer_cache_init(LayerCache* layer) {
+    for(int i = 0; i < STRIP_SLOTS; i++) {
+        layer->strip[i] = -1;
     }
+    layer->decoder = compress_icon_alloc(ICON_DECODE_BUF_SIZE);
     
-    // Clouds don't affect collision
-    return (state->grid[row][col] == CELL_CLOUD) ? CELL_EMPTY : state->grid[row][col];
+    // The cloud is blended into many cells, decode it only once
+    uint8_t* cloud = NULL;
+    compress_icon_decode(layer->decoder, icon_get_frame_data(&I_cloud, 0), &cloud);
+    memcpy(layer->cloud, cloud, sizeof(layer->cloud));
 }
 
-// Check if character collides with a block at given position
-static bool check_block_collision(GameState* state, int world_x, int y_pos) {
-    // Check all four corners of character
-    int left = world_x;
-    int right = world_x + CHAR_WIDTH - 1;
-    int top = y_pos;
-    int bottom = y_pos + CHAR_HEIGHT - 1;
-    
-    // Check corners
-    if(get_cell_at(state, left, top) == CELL_BLOCK) return true;
-    if(get_cell_at(state, right, top) == CELL_BLOCK) return true;
-    if(get_cell_at(state, left, bottom) == CELL_BLOCK) return true;
-    if(get_cell_at(state, right, bottom) == CELL_BLOCK) return true;
-    
-    return false;
+static void layer_cache_free(LayerCache* layer) {
+    compress_icon_free(layer->decoder);
 }
 
-// Collect pills at character position
-static void collect_pills(GameState* state) {
-    int left = state->world_x;
-    int right = state->world_x + CHAR_WIDTH - 1;
-    int top = state->y_pos;
-    int bottom = state->y_pos + CHAR_HEIGHT - 1;
-    
-    // Check cells that character overlaps
-    int col_start = left / CELL_SIZE;
-    int col_end = right / CELL_SIZE;
-    int row_start = top / CELL_SIZE;
-    int row_end = bottom / CELL_SIZE;
-    
-    for(int row = row_start; row <= row_end && row < GRID_ROWS; row++) {
-        for(int col = col_start; col <= col_end && col < GRID_COLS; col++) {
-            if(row >= 0 && col >= 0 && state->grid[row][col] == CELL_PILL) {
-                state->grid[row][col] = CELL_EMPTY;
-                state->score += 10;
-                state->pill_count--;
-            }
+// Composite one strip from the background tiles and the static cells
+static void layer_cache_build(
+    LayerCache* layer, int slot, int strip, uint16_t version, const RenderSnapshot* frame) {
+    uint8_t* bits = layer->bits[slot];
+    memset(bits, 0, sizeof(layer->bits[slot]));
+    int strip_x = strip * STRIP_WIDTH;
+    
+    // Background tiles: strips and tiles are byte aligned, copy whole bytes
+    for(int x = strip_x; x < strip_x + STRIP_WIDTH && x < frame->map_width;) {
+        int tile = x / TILE_WIDTH;
+        int tile_end = (tile + 1) * TILE_WIDTH;
+        int span = MIN(tile_end, strip_x + STRIP_WIDTH) - x;
+        
+        uint8_t* tile_bits = NULL;
+        compress_icon_decode(layer->decoder, icon_get_frame_data(get_tile_icon(frame, tile), 0), &tile_bits);
+        int src = (x - tile * TILE_WIDTH) / 8;
+        int dst = (x - strip_x) / 8;
+        for(int y = 0; y < TILE_HEIGHT; y++) {
+            memcpy(&bits[y * STRIP_STRIDE + dst], &tile_bits[y * (TILE_WIDTH / 8) + src], span / 8);
         }
+        x += span;
     }
-	// Empty diamonds when jumping through them
-    for(int row = row_start; row <= row_end && row < GRID_ROWS; row++) {
-        for(int col = col_start; col <= col_end && col < GRID_COLS; col++) {
-            if(row >= 0 && col >= 0 && state->grid[row][col] == CELL_DIAMOND_FILLED) {
-                if(!state->on_ground) {  // Only fill when jumping/falling
-                    state->grid[row][col] = CELL_DIAMOND;
-					state->filled_diamonds++;
+    
+    // Static cells: blocks are solid boxes, clouds are blended in
+    for(int c = 0; c < STRIP_COLS; c++) {
+        int frame_col = strip * STRIP_COLS + c - frame->first_col;
+        if(frame_col >= frame->num_cols) {
+            break;
+        }
+        int cell_x = c * CELL_SIZE;
+        for(int row = 0; row < GRID_ROWS; row++) {
+            uint8_t kind = cell_sprites[frame->cells[row][frame_col]].kind;
+            if(kind != CellSpriteBlock && kind != CellSpriteCloud) {
+                continue;
+            }
+            for(int dy = 0; dy < CELL_SIZE; dy++) {
+                uint8_t* line = &bits[(row * CELL_SIZE + dy) * STRIP_STRIDE];
+                uint16_t pattern = (kind == CellSpriteBlock) ?
+                    (uint16_t)((1U << CELL_SIZE) - 1) :
+                    (uint16_t)(layer->cloud[dy * 2] | (layer->cloud[dy * 2 + 1] << 8));
+                for(int dx = 0; dx < CELL_SIZE; dx++) {
+                    if(pattern & (1U << dx)) {
+                        int x = cell_x + dx;
+                        line[x / 8] |= 1 << (x % 8);
+                    }
                 }
             }
         }
-     }
-	
+    }
+    
+    layer->strip[slot] = strip;
+    layer->version[slot] = version;
+}
+
+// Draw the static layer of all visible strips, compositing missing ones
+static void draw_static_layer(Canvas* canvas, LayerCache* layer, const RenderSnapshot* frame) {
+    int first_strip = frame->first_col / STRIP_COLS;
+    int num_strips = (frame->num_cols + STRIP_COLS - 1) / STRIP_COLS;
+    for(int i = 0; i < num_strips; i++) {
+        int strip = first_strip + i;
+        int slot = strip % STRIP_SLOTS;
+        if(layer->strip[slot] != strip || layer->version[slot] != frame->strip_version[i]) {
+            layer_cache_build(layer, slot, strip, frame->strip_version[i], frame);
+        }
+        canvas_draw_xbm(canvas, strip * STRIP_WIDTH - frame->camera_x, 0, STRIP_WIDTH, TILE_HEIGHT, layer->bits[slot]);
+    }
 }
 
-// Check if character can stand on a block
-static bool check_ground_support(GameState* state, int world_x, int y_pos) {
-    // Check one pixel below character's feet
-    int feet_y = y_pos + CHAR_HEIGHT;
-    int left = world_x;
-    int right = world_x + CHAR_WIDTH - 1;
+// Invalidate all cached HUD strings
+static void hud_cache_init(HudCache* hud) {
+    hud->valid = false;
+    for(int i = 0; i < LABEL_CACHE_SLOTS; i++) {
+        hud->label_col[i] = -1;
+    }
+}
+
+// Reformat the stats strings if any counter changed since the last frame
+static void hud_cache_update(HudCache* hud, Canvas* canvas, const RenderSnapshot* frame) {
+    if(hud->valid && hud->pill_count == frame->pill_count && hud->block_count == frame->block_count &&
+       hud->ground_blocks == frame->ground_blocks && hud->overall_pills == frame->overall_pills &&
+       hud->overall_diamonds == frame->overall_diamonds &&
+       hud->filled_diamonds == frame->filled_diamonds) {
+        return;
+    }
+    hud->valid = true;
+    hud->pill_count = frame->pill_count;
+    hud->block_count = frame->block_count;
+    hud->ground_blocks = frame->ground_blocks;
+    hud->overall_pills = frame->overall_pills;
+    hud->overall_diamonds = frame->overall_diamonds;
+    hud->filled_diamonds = frame->filled_diamonds;
     
-    if(get_cell_at(state, left, feet_y) == CELL_BLOCK) return true;
-    if(get_cell_at(state, right, feet_y) == CELL_BLOCK) return true;
+    snprintf(hud->blocks_str, HUD_TEXT_SIZE, "B:%d(%d)", frame->ground_blocks, frame->block_count);
+    snprintf(hud->diamonds_str, HUD_TEXT_SIZE, "D:%d(%d)", frame->filled_diamonds, frame->overall_diamonds);
+    int collected_pills = frame->overall_pills - frame->pill_count;  // The score also counts stomps
+    snprintf(hud->pills_str, HUD_TEXT_SIZE, "P:%d(%d)", collected_pills, frame->overall_pills);
     
-    return false;
+    // Measure with the font used for drawing
+    canvas_set_font(canvas, FontSecondary);
+    hud->diamonds_x = (SCREEN_WIDTH - canvas_string_width(canvas, hud->diamonds_str)) / 2;
+    hud->pills_x = SCREEN_WIDTH - canvas_string_width(canvas, hud->pills_str) - 1;
+}
+
+// Get the label text of a grid column, formatting it only on first use
+static const char* hud_column_label(HudCache* hud, int col) {
+    int slot = (col / LABEL_EVERY_COLS) % LABEL_CACHE_SLOTS;
+    if(hud->label_col[slot] != col) {
+        hud->label_col[slot] = col;
+        snprintf(hud->label_str[slot], sizeof(hud->label_str[slot]), "%d", col);
+    }
+    return hud->label_str[slot];
 }
 
 // Draw the grid overlay when enabled
-static void draw_grid_overlay(Canvas* canvas, GameState* state) {
+static void draw_grid_overlay(Canvas* canvas, const RenderSnapshot* frame, HudCache* hud) {
     // Set font for labels
     canvas_set_font(canvas, FontSecondary);
     
-    // Calculate which columns are visible on screen
-    int first_col = state->camera_x / CELL_SIZE;
-    int last_col = (state->camera_x + SCREEN_WIDTH) / CELL_SIZE + 1;
-    
-    // Clamp to grid boundaries
-    if(first_col < 0) first_col = 0;
-    if(last_col >= GRID_COLS) last_col = GRID_COLS;
-    
-    // Draw vertical lines for each column
-    for(int col = first_col; col <= last_col; col++) {
+    // Draw vertical lines for each visible column, and the one closing the last
+    for(int col = frame->first_col; col <= frame->first_col + frame->num_cols; col++) {
         int world_x = col * CELL_SIZE;
-        int screen_x = world_x - state->camera_x;
+        int screen_x = world_x - frame->camera_x;
         
         // Only draw if on screen
         if(screen_x >= 0 && screen_x < SCREEN_WIDTH) {
             canvas_draw_line(canvas, screen_x, 0, screen_x, SCREEN_HEIGHT - 1);
             
             // Draw column number label at every 5th column in row 1 (2nd row from top)
-            if(col % 5 == 0) {
-                char label[8];
-                snprintf(label, sizeof(label), "%d", col);
-                
+            if(col % LABEL_EVERY_COLS == 0) {
                 // Position label in the center of the cell in row 1
                 int label_x = screen_x + 2;  // Small offset from left edge
                 int label_y = CELL_SIZE + 7;  // Row 1, vertically centered
                 
                 // Only draw if label fits on screen
                 if(label_x >= 0 && label_x < SCREEN_WIDTH - 10) {
-                    canvas_draw_str(canvas, label_x, label_y, label);
+                    canvas_draw_str(canvas, label_x, label_y, hud_column_label(hud, col));
                 }
             }
         }
@@ -399,407 +587,618 @@ static void draw_grid_overlay(Canvas* canvas, GameState* state) {
 // Draw callback function
 static void draw_callback(Canvas* canvas, void* ctx) {
     GameState* state = (GameState*)ctx;
+    uint32_t start = DWT->CYCCNT;
+    const RenderSnapshot* frame = render_acquire(&state->render);
     canvas_clear(canvas);
-
-    // Calculate which tiles are visible
-    int first_tile = state->camera_x / TILE_WIDTH;
-    int last_tile = (state->camera_x + SCREEN_WIDTH) / TILE_WIDTH;
     
-    // Clamp tile indices
-    if(first_tile < 0) first_tile = 0;
-    if(last_tile >= NUM_TILES) last_tile = NUM_TILES - 1;
+    // Title art, centered, until the level starts
+    if(frame->splash != NULL) {
+        const AssetImage* image = frame->splash;
+        canvas_draw_xbm(
+            canvas,
+            (SCREEN_WIDTH - image->width) / 2,
+            (SCREEN_HEIGHT - image->height) / 2,
+            image->width,
+            image->height,
+            image->bits);
+        return;
+    }
 
-    // Draw background tiles
-    for(int i = first_tile; i <= last_tile; i++) {
-        int tile_world_x = i * TILE_WIDTH;
-        int tile_screen_x = tile_world_x - state->camera_x;
-        
-        // Select the appropriate tile icon
-        const Icon* tile_icon = NULL;
-        switch(i) {
-            case 0:
-                tile_icon = &I_map_tile_0;
-                break;
-            case 1:
-                tile_icon = &I_map_tile_1;
+    // Draw background tiles, clouds and blocks from the static layer cache
+    PROFILE_BEGIN(ProfileStageLayer);
+    draw_static_layer(canvas, &state->layer, frame);
+    PROFILE_END(ProfileStageLayer);
+    
+    // Draw grid overlay if enabled
+    PROFILE_BEGIN(ProfileStageGrid);
+    if(frame->grid_view_enabled) {
+        draw_grid_overlay(canvas, frame, &state->hud);
+    }
+    PROFILE_END(ProfileStageGrid);
+    
+    // Draw the visible dynamic cells (pills and diamonds) in a single pass,
+    // then the entities
+    PROFILE_BEGIN(ProfileStageCells);
+    for(int c = 0; c < frame->num_cols; c++) {
+        int screen_x = (frame->first_col + c) * CELL_SIZE - frame->camera_x;
+        if(screen_x <= -CELL_SIZE || screen_x >= SCREEN_WIDTH) {
+            continue;
+        }
+        for(int row = 0; row < GRID_ROWS; row++) {
+            int y = row * CELL_SIZE;
+            const CellSprite* sprite = &cell_sprites[frame->cells[row][c]];
+            switch(sprite->kind) {
+            case CellSpriteDisc:
+                canvas_draw_disc(canvas, screen_x + CELL_SIZE/2, y + CELL_SIZE/2, 3);
                 break;
-            case 2:
-                tile_icon = &I_map_tile_2;
+            case CellSpriteIcon:
+                canvas_draw_icon(canvas, screen_x, y, sprite->icon);
                 break;
-        }
-        
-        if(tile_icon != NULL) {
-            canvas_draw_icon(canvas, tile_screen_x, 0, tile_icon);
+            default:
+                break;  // Empty, or in the static layer
+            }
         }
     }
     
-    // Draw grid overlay if enabled
-    if(state->grid_view_enabled) {
-        draw_grid_overlay(canvas, state);
-    }
-    // Draw clouds first (so they appear behind everything else)
-    for(int row = 0; row < GRID_ROWS; row++) {
-        for(int col = 0; col < GRID_COLS; col++) {
-            if(state->grid[row][col] == CELL_CLOUD) {
-                int world_x = col * CELL_SIZE;
-                int screen_x = world_x - state->camera_x;
-                
-                // Only draw if visible on screen
-                if(screen_x >= -CELL_SIZE && screen_x < SCREEN_WIDTH) {
-                    int y = row * CELL_SIZE;
-                    canvas_draw_icon(canvas, screen_x, y, &I_cloud);
-                }
-            }
-        }
-    }	
-    
-    // Draw grid cells (blocks and pills)
-    for(int row = 0; row < GRID_ROWS; row++) {
-        for(int col = 0; col < GRID_COLS; col++) {
-            if(state->grid[row][col] != CELL_EMPTY && state->grid[row][col] != CELL_CLOUD) {
-                int world_x = col * CELL_SIZE;
-                int screen_x = world_x - state->camera_x;
-                
-                // Only draw if visible on screen
-                if(screen_x >= -CELL_SIZE && screen_x < SCREEN_WIDTH) {
-                    int y = row * CELL_SIZE;
-                    
-                    if(state->grid[row][col] == CELL_BLOCK) {
-                        // Draw block as filled rectangle
-                        canvas_draw_box(canvas, screen_x, y, CELL_SIZE, CELL_SIZE);
-                    } else if(state->grid[row][col] == CELL_PILL) {
-                        // Draw pill as circle
-                        canvas_draw_disc(canvas, screen_x + CELL_SIZE/2, y + CELL_SIZE/2, 3);
-                    } else if(state->grid[row][col] == CELL_DIAMOND) {
-                        canvas_draw_icon(canvas, screen_x, y, &I_diamond_empty);
-                    } else if(state->grid[row][col] == CELL_DIAMOND_FILLED) {
-                        canvas_draw_icon(canvas, screen_x, y, &I_diamond_full);
-                    }
-                }
-            }
+    // Draw the entities, the toaster images are illustrations, far too big
+    // for sprites, so they are drawn from primitives
+    for(int i = 0; i < frame->num_entities; i++) {
+        int x = frame->entity_x[i];
+        int y = frame->entity_y[i];
+        if(frame->entity_type[i] == EntityToaster) {
+            // Body with a slot on top, an eye on the side it walks to and two legs
+            canvas_draw_rframe(canvas, x, y + 1, 10, 7, 2);
+            canvas_draw_line(canvas, x + 3, y, x + 6, y);
+            canvas_draw_dot(canvas, frame->entity_right[i] ? x + 7 : x + 2, y + 3);
+            canvas_draw_line(canvas, x + 2, y + 8, x + 2, y + 9);
+            canvas_draw_line(canvas, x + 7, y + 8, x + 7, y + 9);
+        } else {
+            canvas_draw_box(canvas, x, y, 2, 2);
         }
     }
+    PROFILE_END(ProfileStageCells);
+    
 	// Draw solid ground box
     canvas_draw_box(canvas, 0, GROUND_Y, SCREEN_WIDTH, SCREEN_HEIGHT - GROUND_Y);
 
     // Draw character PANIS 
-    const Icon* char_icon = state->facing_right ? &I_bread_r : &I_bread_l;
-    canvas_draw_icon(canvas, state->screen_x, state->y_pos, char_icon);
+    const Icon* char_icon = frame->facing_right ? &I_bread_r : &I_bread_l;
+    canvas_draw_icon(canvas, frame->screen_x, frame->y_pos, char_icon);
 
     // Draw stats at top 
-    char stats_str[32];
+    PROFILE_BEGIN(ProfileStageHud);
+    HudCache* hud = &state->hud;
+    hud_cache_update(hud, canvas, frame);
     canvas_set_font(canvas, FontSecondary);
   
     // Left: Block counter "B: [ground]/[total]"
-    snprintf(stats_str, sizeof(stats_str), "B:%d(%d)", state->ground_blocks, state->block_count);
-    canvas_draw_str(canvas, 1, 7, stats_str);
+    canvas_draw_str(canvas, 1, 7, hud->blocks_str);
     
     // Center: Diamond counter "D: [filled]/[overall]"
-    snprintf(stats_str, sizeof(stats_str), "D:%d(%d)", state->filled_diamonds, state->overall_diamonds);
-    int text_width = canvas_string_width(canvas, stats_str);
-    canvas_draw_str(canvas, (SCREEN_WIDTH - text_width) / 2, 7, stats_str);
+    canvas_draw_str(canvas, hud->diamonds_x, 7, hud->diamonds_str);
     
     // Right: Pill counter "P: [collected]/[overall]"
-    int collected_pills = state->score / 10;
-    snprintf(stats_str, sizeof(stats_str), "P:%d(%d)", collected_pills, state->overall_pills);
-    text_width = canvas_string_width(canvas, stats_str);
-    canvas_draw_str(canvas, SCREEN_WIDTH - text_width - 1, 7, stats_str);
+    canvas_draw_str(canvas, hud->pills_x, 7, hud->pills_str);
+    PROFILE_END(ProfileStageHud);
+    
+#ifdef PANIS_PROFILER
+    profiler_frame();
+    if(frame->profiler_enabled) {
+        profiler_draw(canvas);
+    }
+#endif
     
     // Reset color to black for other drawing
     canvas_set_color(canvas, ColorBlack);	
+    trace_record(TraceDraw, 0, DWT->CYCCNT - start);
+}
+
+// Show the title art until a key is released or SPLASH_MS passed. Nothing
+// is simulated meanwhile, and the keys pressed are not passed on to the game.
+static void show_splash(GameState* state, ViewPort* view_port, Asset asset) {
+    state->splash = asset_cache_get(state->assets, asset);
+    if(state->splash == NULL) {
+        return;  // Art not on the SD card, start right away
+    }
+    render_publish(state);
+    view_port_update(view_port);
+    
+    uint32_t start = furi_get_tick();
+    uint32_t duration = furi_ms_to_ticks(SPLASH_MS);
+    uint32_t elapsed;
+    InputEvent event;
+    while((elapsed = furi_get_tick() - start) < duration) {
+        if(furi_message_queue_get(state->input_queue, &event, duration - elapsed) == FuriStatusOk &&
+           event.type == InputTypeRelease) {
+            break;
+        }
+    }
+    furi_message_queue_reset(state->input_queue);
+    state->splash = NULL;
+    render_publish(state);
+    view_port_update(view_port);
+}
+
+// Frame timer callback: wake up the game loop for the next frame
+static void frame_timer_callback(void* ctx) {
+    FuriThreadId thread_id = ctx;
+    furi_thread_flags_set(thread_id, FRAME_FLAG_TICK);
 }
 
 // Input callback function
 static void input_callback(InputEvent* input_event, void* ctx) {
     furi_assert(ctx);
-    FuriMessageQueue* event_queue = ctx;
-    furi_message_queue_put(event_queue, input_event, FuriWaitForever);
+    GameState* state = ctx;
+    
+    // Track held keys right here, so a dropped event can't leave a key stuck
+    uint32_t bit = KEY_BIT(input_event->key);
+    if(input_event->type == InputTypePress) {
+        atomic_fetch_or(&state->held_keys, bit);
+    } else if(input_event->type == InputTypeRelease) {
+        atomic_fetch_and(&state->held_keys, ~bit);
+    }
+    
+    // Repeat events are covered by the held state. Never block the input
+    // service: when the queue is full the event is dropped.
+    if(input_event->type != InputTypeRepeat) {
+        furi_message_queue_put(state->input_queue, input_event, 0);
+        furi_thread_flags_set(state->loop_thread, FRAME_FLAG_INPUT);
+    }
 }
 
-// Apply gravity and update Y position
-static void update_physics(GameState* state) {
-    // Apply gravity
-    if(!state->on_ground) {
-        state->y_velocity += GRAVITY;
-        if(state->y_velocity > MAX_FALL_SPEED) {
-            state->y_velocity = MAX_FALL_SPEED;
+// Handle a key event, live or replayed
+static void handle_input_event(GameState* state, InputKey key, InputType type) {
+    trace_record(TraceInput, key, type);
+    if(key == InputKeyOk) {
+        // Short press plays the melody, long press restarts the level. With
+        // down held a long press writes the trace to the SD card instead.
+        if(type == InputTypeShort) {
+#ifdef PANIS_PROFILER
+            // With down held it toggles the profiler instead
+            if(state->keys & KEY_BIT(InputKeyDown)) {
+                state->profiler_enabled = !state->profiler_enabled;
+                state->dirty = true;
+                return;
+            }
+#endif
+            audio_player_play(state->audio, AudioSoundMelody);
+        } else if(type == InputTypeLong && (state->keys & KEY_BIT(InputKeyDown))) {
+            trace_dump(state->storage, TRACE_PATH);
+            notification_message(state->notifications, &sequence_single_vibro);
+        } else if(type == InputTypeLong) {
+            game_restart(&state->game);
         }
+        return;
     }
-    
-    // Try to update Y position
-    int new_y = state->y_pos + state->y_velocity;
-    
-    // Limit maximum jump height
-    int max_height_y = GROUND_Y - CHAR_HEIGHT - MAX_JUMP_HEIGHT;
-    if(new_y < max_height_y) {
-        new_y = max_height_y;
-        state->y_velocity = 0;  // Stop upward movement
+    if(type != InputTypePress) {
+        return;
+    }
+    switch(key) {
+    case InputKeyBack:
+        state->running = false;
+        break;
+    case InputKeyUp:
+        game_jump(&state->game, state->steps * PHYSICS_STEP_MS);
+        break;
+    case InputKeyLeft:
+    case InputKeyRight:
+        // Move immediately on press, holding continues in update_movement
+        PROFILE_BEGIN(ProfileStageGame);
+        game_move(&state->game, key == InputKeyRight ? GameDirectionRight : GameDirectionLeft);
+        PROFILE_END(ProfileStageGame);
+        state->moved_keys |= KEY_BIT(key);
+        break;
+    default:
+        break;
+    }
+}
+
+// Add an input to the recording, if one is running
+static void record_input(GameState* state, uint8_t key, uint8_t type) {
+    if(state->recorder != NULL) {
+        InputRecord record = {.step = state->steps, .key = key, .type = type};
+        input_log_write(state->recorder, &record);
+    }
+}
+
+// Feed the recorded input up to the current physics step back into the game
+static void replay_input(GameState* state) {
+    if(state->replay == NULL) {
+        return;
+    }
+    InputRecord record;
+    bool more;
+    while((more = input_log_peek(state->replay, &record)) && record.key != INPUT_LOG_END &&
+          record.step <= state->steps) {
+        input_log_next(state->replay);
+        if(record.type & INPUT_LOG_HELD) {
+            uint32_t bit = KEY_BIT(record.key);
+            bool pressed = (record.type & ~INPUT_LOG_HELD) == InputTypePress;
+            state->keys = pressed ? (state->keys | bit) : (state->keys & ~bit);
+        } else {
+            handle_input_event(state, record.key, record.type);
+        }
     }
     
-    // Check collision with blocks
-    if(state->y_velocity > 0) {  // Falling down
-        // Check if we hit a block below
-        if(check_ground_support(state, state->world_x, new_y - 1)) {
-            // Land on the block
-            int feet_y = new_y + CHAR_HEIGHT;
-            int block_row = feet_y / CELL_SIZE;
-            state->y_pos = block_row * CELL_SIZE - CHAR_HEIGHT;
-            state->y_velocity = 0;
-            state->on_ground = true;
-            return;
+    // Back to live input at the end of the recording
+    if(!more || (record.key == INPUT_LOG_END && record.step <= state->steps)) {
+        FURI_LOG_I(TAG, "Replay finished after %lu steps", (unsigned long)state->steps);
+        input_log_close(state->replay, state->steps);
+        state->replay = NULL;
+        state->keys = 0;
+    }
+}
+
+// Drain all pending input events and handle key presses
+static void process_input(GameState* state) {
+    InputEvent event;
+    while(furi_message_queue_get(state->input_queue, &event, 0) == FuriStatusOk) {
+        if(state->replay != NULL) {
+            // Live input is ignored during a replay, except for leaving
+            if(event.key == InputKeyBack && event.type == InputTypePress) {
+                state->running = false;
+                return;
+            }
+            continue;
         }
-    } else if(state->y_velocity < 0) {  // Moving up
-        // Check if we hit a block above
-        if(check_block_collision(state, state->world_x, new_y)) {
-            state->y_velocity = 0;
-            trigger_vibration(state);
+        record_input(state, event.key, event.type);
+        handle_input_event(state, event.key, event.type);
+        if(!state->running) {
             return;
         }
     }
     
-    state->y_pos = new_y;
-    
-    // Ground collision
-    int ground_pos = GROUND_Y - CHAR_HEIGHT;
-    if(state->y_pos >= ground_pos) {
-        state->y_pos = ground_pos;
-        state->y_velocity = 0;
-        state->on_ground = true;
+    if(state->replay != NULL) {
+        replay_input(state);
     } else {
-        state->on_ground = false;
+        // Sample the held keys once per frame and record the changes
+        uint32_t keys = atomic_load(&state->held_keys);
+        uint32_t changed = keys ^ state->keys;
+        for(int key = 0; key < InputKeyMAX; key++) {
+            if(changed & KEY_BIT(key)) {
+                InputType type = (keys & KEY_BIT(key)) ? InputTypePress : InputTypeRelease;
+                record_input(state, key, INPUT_LOG_HELD | type);
+            }
+        }
+        state->keys = keys;
     }
     
-    // Collect any pills at current position
-    collect_pills(state);
+    // Grid view is shown while the down button is held
+    bool grid_view_enabled = (state->keys & KEY_BIT(InputKeyDown)) != 0;
+    if(grid_view_enabled != state->grid_view_enabled) {
+        state->grid_view_enabled = grid_view_enabled;
+        state->dirty = true;
+    }
 }
 
-// Handle jump input
-static void handle_jump(GameState* state) {
-    if(state->on_ground) {
-        uint32_t current_time = furi_get_tick();
-        bool is_double_click = (current_time - state->last_jump_time) < DOUBLE_CLICK_MS;
-        
-        // Double-click = big jump, single click = small jump
-        state->y_velocity = is_double_click ? BIG_JUMP_VELOCITY : SMALL_JUMP_VELOCITY;
-        
-        state->last_jump_time = current_time;
-        state->on_ground = false;
+// Continue horizontal movement while a direction key is held
+static void update_movement(GameState* state) {
+    uint32_t keys = state->keys & MOVE_KEYS & ~state->moved_keys;
+    state->moved_keys = 0;
+    if(keys == 0) {
+        return;
     }
+    
+    PROFILE_BEGIN(ProfileStageGame);
+    if(keys & KEY_BIT(InputKeyRight)) {
+        game_move(&state->game, GameDirectionRight);
+    } else {
+        game_move(&state->game, GameDirectionLeft);
+    }
+    PROFILE_END(ProfileStageGame);
 }
 
-// Update horizontal movement logic
-static void update_game(GameState* state, InputKey key) {   
-    int old_world_x = state->world_x;
-    int new_world_x = state->world_x;
-    int new_screen_x = state->screen_x;
-    int new_camera_x = state->camera_x;
-    
-    if(key == InputKeyRight) {
-        state->facing_right = true;
-        
-        // Check if we can move right
-        if(state->world_x < TOTAL_MAP_WIDTH - CHAR_WIDTH) {
-            // Calculate new position
-            new_world_x = state->world_x + MOVEMENT_SPEED;
-            
-            // Check for block collision
-            if(check_block_collision(state, new_world_x, state->y_pos)) {
-                trigger_vibration(state);
-                return;
-            }
-            
-            // Determine if we should scroll or move character
-            if(state->screen_x >= START_SCROLL_X && 
-               state->camera_x < TOTAL_MAP_WIDTH - SCREEN_WIDTH) {
-                // Scroll the world
-                new_camera_x = state->camera_x + MOVEMENT_SPEED;
-                
-                // Clamp camera
-                if(new_camera_x > TOTAL_MAP_WIDTH - SCREEN_WIDTH) {
-                    int overflow = new_camera_x - (TOTAL_MAP_WIDTH - SCREEN_WIDTH);
-                    new_camera_x = TOTAL_MAP_WIDTH - SCREEN_WIDTH;
-                    new_screen_x = state->screen_x + overflow;
-                } else {
-                    new_screen_x = state->screen_x;
-                }
-            } else {
-                // Move character on screen
-                new_screen_x = state->screen_x + MOVEMENT_SPEED;
-                new_camera_x = state->camera_x;
-                
-                // Clamp to screen edge
-                if(new_screen_x > SCREEN_WIDTH - CHAR_WIDTH) {
-                    new_screen_x = SCREEN_WIDTH - CHAR_WIDTH;
-                }
-            }
-            
-            // Clamp world position
-            if(new_world_x > TOTAL_MAP_WIDTH - CHAR_WIDTH) {
-                new_world_x = TOTAL_MAP_WIDTH - CHAR_WIDTH;
-            }
-            
-            state->world_x = new_world_x;
-            state->screen_x = new_screen_x;
-            state->camera_x = new_camera_x;
+// Check if the space separated launch arguments contain a word
+static bool has_arg(const char* args, const char* word) {
+    size_t length = strlen(word);
+    while(args != NULL && *args != '\0') {
+        if(strncmp(args, word, length) == 0 && (args[length] == ' ' || args[length] == '\0')) {
+            return true;
         }
-    } else if(key == InputKeyLeft) {
-        state->facing_right = false;
-        
-        // Check if we can move left
-        if(state->world_x > 0) {
-            // Calculate new position
-            new_world_x = state->world_x - MOVEMENT_SPEED;
-            
-            // Check for block collision
-            if(check_block_collision(state, new_world_x, state->y_pos)) {
-                trigger_vibration(state);
-                return;
-            }
-            
-            // Determine if we should scroll or move character
-            if(state->screen_x <= START_SCROLL_X && state->camera_x > 0) {
-                // Scroll the world (move camera left)
-                new_camera_x = state->camera_x - MOVEMENT_SPEED;
-                
-                // Clamp camera
-                if(new_camera_x < 0) {
-                    int overflow = -new_camera_x;
-                    new_camera_x = 0;
-                    new_screen_x = state->screen_x - overflow;
-                } else {
-                    new_screen_x = state->screen_x;
-                }
-            } else {
-                // Move character on screen
-                new_screen_x = state->screen_x - MOVEMENT_SPEED;
-                new_camera_x = state->camera_x;
-                
-                // Clamp to screen edge
-                if(new_screen_x < 0) {
-                    new_screen_x = 0;
-                }
-            }
-            
-            // Clamp world position
-            if(new_world_x < 0) {
-                new_world_x = 0;
-            }
-            
-            state->world_x = new_world_x;
-            state->screen_x = new_screen_x;
-            state->camera_x = new_camera_x;
+        args = strchr(args, ' ');
+        if(args != NULL) {
+            args++;
         }
     }
-    
-    // Vibrate if we hit a boundary
-    if((old_world_x != state->world_x) && 
-       (state->world_x == 0 || state->world_x == TOTAL_MAP_WIDTH - CHAR_WIDTH)) {
-        trigger_vibration(state);
+    return false;
+}
+
+// True when a frame would not change anything without new input
+static bool is_idle(GameState* state) {
+#ifdef PANIS_PROFILER
+    if(state->profiler_enabled) {
+        return false;
+    }
+#endif
+    return state->keys == 0 && state->replay == NULL && state->feedback.pending == 0 &&
+           !state->dirty && game_is_idle(&state->game);
+}
+
+// Stop the frame timer and sleep until the next input event, then resume at
+// the full frame rate. The game is paused meanwhile, no physics steps run.
+static void sleep_until_input(GameState* state, FuriTimer* frame_timer) {
+    furi_timer_stop(frame_timer);
+    // Events that arrived before the flag was cleared are still in the queue
+    furi_thread_flags_clear(FRAME_FLAG_TICK | FRAME_FLAG_INPUT);
+    if(furi_message_queue_get_count(state->input_queue) == 0 &&
+       atomic_load(&state->held_keys) == 0) {
+        trace_record(TraceSleep, 0, 0);
+        furi_thread_flags_wait(FRAME_FLAG_INPUT, FuriFlagWaitAny, FuriWaitForever);
+        trace_record(TraceWake, 0, 0);
     }
+    furi_timer_start(frame_timer, furi_ms_to_ticks(1000 / FRAME_RATE_HZ));
 }
 
 // Main application entry point
 int32_t panis_main(void* p) {
-    UNUSED(p);
+    const char* args = p;
     
-    // Create event queue for input events
-    FuriMessageQueue* event_queue = furi_message_queue_alloc(8, sizeof(InputEvent));
-    
-    // Initialize game state
-    GameState* state = malloc(sizeof(GameState));
-    state->world_x = CHAR_START_X;  // Start at 1/4 of screen width
-    state->screen_x = CHAR_START_X;
-    state->camera_x = 0;
-    state->facing_right = true;
+    // Initialize game state, all memory of the app comes from the arena
+    arena_init();
+    trace_init();
+    GameState* state = arena_alloc(ArenaGame, sizeof(GameState));
     state->running = true;
-    state->y_pos = GROUND_Y - CHAR_HEIGHT;
-    state->y_velocity = 0;
-    state->on_ground = true;
-    state->last_jump_time = 0;
     state->notifications = furi_record_open(RECORD_NOTIFICATION);
     state->grid_view_enabled = false;  // Grid view starts disabled
-	state->melody_thread = NULL;  // No melody thread initially
+#ifdef PANIS_PROFILER
+    state->profiler_enabled = false;
+    profiler_init();
+#endif
+    state->audio = audio_player_alloc();
+    feedback_init(&state->feedback, furi_get_tick());
+    state->input_queue = furi_message_queue_alloc(INPUT_QUEUE_SIZE, sizeof(InputEvent));
+    state->loop_thread = furi_thread_get_current_id();
+    atomic_init(&state->held_keys, 0);
+    state->keys = 0;
+    state->moved_keys = 0;
+    state->steps = 0;
+    state->dirty = true;  // Draw the first frame
+    memset(state->game.chunk_version, 0, sizeof(state->game.chunk_version));
+    
+    // Play the level from SD card if there is one, else a level generated from
+    // a random seed. The arguments "builtin" and "random" pick the built-in or
+    // a generated level instead of the one on the SD card.
+    // A replay plays the level and seed of its recording. Without arguments
+    // the game continues where it was left.
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    state->storage = storage;
+    state->level_file = level_file_open(storage, LEVEL_FILE_PATH, GRID_ROWS, CHUNK_COLS);
+    InputLogLevel level_source;
+    uint32_t seed;
+    GameProgress* progress = arena_alloc(ArenaGame, sizeof(GameProgress));
+    bool first_launch = !storage_file_exists(storage, RESUME_FILE_PATH);  // Progress is saved on every exit
+    bool resume = false;
+    bool bench = false;
+    state->replay = NULL;
+#ifdef PANIS_PROFILER
+    // Launching with the argument "bench" runs the stress benchmark instead
+    bench = has_arg(args, "bench");
+    if(bench) {
+        size_t script_size;
+        const InputRecord* script = bench_get_script(&script_size);
+        state->replay = input_log_script(script, script_size);
+        level_source = InputLogLevelGenerated;
+        seed = BENCH_SEED;
+    }
+#endif
+    if(!bench && has_arg(args, "replay")) {
+        state->replay = input_log_replay(storage, INPUT_LOG_PATH, &level_source, &seed);
+    }
+    if(state->replay == NULL && !has_arg(args, "random") && !has_arg(args, "builtin") &&
+       !has_arg(args, "record")) {
+        resume = resume_file_load(storage, RESUME_FILE_PATH, &level_source, &seed, progress) &&
+                 (level_source == InputLogLevelFile) == (state->level_file != NULL);
+    }
+    if(state->replay == NULL && !resume) {
+        if(has_arg(args, "builtin")) {
+            level_source = InputLogLevelBuiltin;
+        } else if(state->level_file != NULL && !has_arg(args, "random")) {
+            level_source = InputLogLevelFile;
+        } else {
+            level_source = InputLogLevelGenerated;
+        }
+        seed = furi_hal_random_get();
+    } else if(level_source == InputLogLevelFile && state->level_file == NULL) {
+        FURI_LOG_W(TAG, "Level file of the recording is missing");
+        level_source = InputLogLevelBuiltin;
+    }
+    GameLevel level = {0};
+    if(level_source == InputLogLevelFile) {
+        level.num_chunks = level_file_get_num_chunks(state->level_file);
+        level.num_tiles = level_file_get_num_tiles(state->level_file);
+        level.tiles = level_file_get_tiles(state->level_file);
+        level.read_chunk = read_level_file_chunk;
+        level.context = state->level_file;
+        level.id = level_file_get_id(state->level_file);
+    } else if(level_source == InputLogLevelBuiltin) {
+        level.num_chunks = builtin_level.num_chunks;
+        level.num_tiles = builtin_level.num_tiles;
+        level.tiles = builtin_level.tiles;
+        level.read_chunk = game_read_builtin_chunk;
+        level.context = (void*)&builtin_level;
+        level.id = builtin_level.id;
+    }
+#ifdef PANIS_PROFILER
+    if(bench) {
+        bench_get_level(&level);
+    }
+#endif
+    FURI_LOG_I(TAG, "Level seed %lu", (unsigned long)seed);
+    resume = resume && game_resume(&state->game, &level, seed, progress);
+    if(!resume) {
+        game_init(&state->game, &level, seed);
+    }
+    state->prefetcher = chunk_prefetcher_alloc();
     
-    // Initialize collision grid
-    init_grid(state);
+    // Launching with the argument "record" records the session for replays
+    state->recorder = NULL;
+    if(state->replay == NULL && has_arg(args, "record")) {
+        state->recorder = input_log_record(storage, INPUT_LOG_PATH, level_source, seed);
+    }
+    
+    // Publish the first frame before the view port can draw
+    hud_cache_init(&state->hud);
+    layer_cache_init(&state->layer);
+    render_init(&state->render);
+    render_publish(state);
     
     // Set up view port
     ViewPort* view_port = view_port_alloc();
     view_port_draw_callback_set(view_port, draw_callback, state);
-    view_port_input_callback_set(view_port, input_callback, event_queue);
+    view_port_input_callback_set(view_port, input_callback, state);
     
     // Register view port in GUI
     Gui* gui = furi_record_open(RECORD_GUI);
     gui_add_view_port(gui, view_port, GuiLayerFullscreen);
     
+    // Title art on the first launch only, later launches, replays and the
+    // benchmark start right away
+    state->assets = asset_cache_alloc(storage);
+    if(first_launch && state->replay == NULL && !bench) {
+        show_splash(state, view_port, AssetToasterOfDeath);
+    }
+    
+    // Frame timer wakes the game loop at a fixed rate, independent of input,
+    // it is stopped while the game is idle
+    FuriTimer* frame_timer = furi_timer_alloc(
+        frame_timer_callback, FuriTimerTypePeriodic, state->loop_thread);
+    furi_timer_start(frame_timer, furi_ms_to_ticks(1000 / FRAME_RATE_HZ));
+    
     // Main game loop
-    InputEvent event;
+    const uint32_t physics_step = furi_ms_to_ticks(PHYSICS_STEP_MS);
+    uint32_t last_tick = furi_get_tick();
+    uint32_t accumulator = 0;  // Elapsed time not yet simulated (in ticks)
+    int idle_frames = 0;       // Frames in a row in which nothing happened
+#ifdef PANIS_PROFILER
+    uint32_t bench_frames = 0;
+    uint32_t bench_start = furi_get_tick();
+    size_t heap_free_min = memmgr_get_free_heap();
+    if(bench) {
+        profiler_histograms_start();
+    }
+#endif
     while(state->running) {
-        // Process input events
-        if(furi_message_queue_get(event_queue, &event, 100) == FuriStatusOk) {
-            // Handle back button
-            if(event.key == InputKeyBack && event.type == InputTypePress) {
-                state->running = false;
-                continue;
-            }
-            
-            // Handle grid view toggle with down button
-            if(event.key == InputKeyDown) {
-                if(event.type == InputTypePress) {
-                    state->grid_view_enabled = true;
-                } else if(event.type == InputTypeRelease) {
-                    state->grid_view_enabled = false;
-                }
-            }
-			
-            // Handle OK button to play melody
-            if(event.key == InputKeyOk && event.type == InputTypePress) {
-                play_melody_async(state);
-            }		
-            
-            // Handle jumping
-            if(event.key == InputKeyUp) {
-                if(event.type == InputTypePress) {
-                   handle_jump(state);
-                }
-            }
-            
-            // Handle horizontal movement
-            if((event.type == InputTypePress || event.type == InputTypeRepeat) &&
-               (event.key == InputKeyLeft || event.key == InputKeyRight)) {
-                update_game(state, event.key);
+        // Wait for the next frame, or for input after a while of idling. The
+        // time asleep is not simulated.
+        if(idle_frames >= IDLE_FRAMES) {
+            sleep_until_input(state, frame_timer);
+            last_tick = furi_get_tick();
+            accumulator = 0;
+            idle_frames = 0;
+        } else {
+            furi_thread_flags_wait(FRAME_FLAG_TICK, FuriFlagWaitAny, FuriWaitForever);
+        }
+        
+        // Process all input that arrived since the last frame
+        PROFILE_BEGIN(ProfileStageInput);
+        process_input(state);
+        PROFILE_END(ProfileStageInput);
+        if(!state->running) {
+            break;
+        }
+        
+        // Run as many fixed physics steps as real time has passed
+        uint32_t now = furi_get_tick();
+        accumulator += now - last_tick;
+        last_tick = now;
+        int steps = 0;
+        while(accumulator >= physics_step && steps < MAX_PHYSICS_STEPS) {
+            uint32_t step_start = DWT->CYCCNT;
+            replay_input(state);
+            update_movement(state);
+            PROFILE_BEGIN(ProfileStagePhysics);
+            game_update_physics(&state->game);
+            PROFILE_END(ProfileStagePhysics);
+            PROFILE_BEGIN(ProfileStageCollect);
+            game_collect_pills(&state->game);
+            PROFILE_END(ProfileStageCollect);
+            if(state->steps % GAME_SUBSTEPS == 0) {
+                PROFILE_BEGIN(ProfileStageEntities);
+                game_update_entities(&state->game);
+                PROFILE_END(ProfileStageEntities);
             }
+            trace_record(TraceStep, state->game.y_pos, DWT->CYCCNT - step_start);
+            accumulator -= physics_step;
+            steps++;
+            state->steps++;
+        }
+        // Drop the backlog after a stall instead of fast-forwarding the game
+        if(steps == MAX_PHYSICS_STEPS) {
+            accumulator = 0;
         }
         
-        // Update physics every frame (independent of input)
-        update_physics(state);
+        handle_game_events(state);
+        chunk_prefetcher_update(state->prefetcher, &state->game);
+        trace_record(TraceFrame, steps, state->steps);
         
-        // Request redraw
-        view_port_update(view_port);
-    }
-	
-	// Stop and cleanup melody thread if still running
-    if(state->melody_thread != NULL) {
-        FuriThreadState thread_state = furi_thread_get_state(state->melody_thread);
-        if(thread_state != FuriThreadStateStopped) {
-            // Thread is still running, wait for it with timeout
-            furi_thread_join(state->melody_thread);
+        // Request redraw only if something changed, the profiler and the
+        // benchmark need all frames
+#ifdef PANIS_PROFILER
+        if(state->profiler_enabled || bench) {
+            state->dirty = true;
+        }
+#endif
+        if(state->dirty) {
+            state->dirty = false;
+            render_publish(state);
+            view_port_update(view_port);
         }
-        // Free the thread
-        if(state->melody_thread != NULL) {
-            furi_thread_free(state->melody_thread);
-            state->melody_thread = NULL;
+        idle_frames = is_idle(state) ? idle_frames + 1 : 0;
+#ifdef PANIS_PROFILER
+        if(bench) {
+            heap_free_min = MIN(heap_free_min, memmgr_get_free_heap());
+            if(++bench_frames == BENCH_FRAMES) {
+                state->running = false;
+            }
         }
+#endif
     }
+	
+    // Stop the workers, the prefetcher before the level file is closed
+    audio_player_free(state->audio);
+    chunk_prefetcher_free(state->prefetcher, &state->game);
     
     // Cleanup
+    furi_timer_stop(frame_timer);
+    furi_timer_free(frame_timer);
     view_port_enabled_set(view_port, false);
     gui_remove_view_port(gui, view_port);
     view_port_free(view_port);
     furi_record_close(RECORD_GUI);
     furi_record_close(RECORD_NOTIFICATION);
-    furi_message_queue_free(event_queue);
-    free(state);
+    if(state->level_file != NULL) {
+        level_file_close(state->level_file);
+    }
+    if(state->recorder != NULL) {
+        input_log_close(state->recorder, state->steps);
+    }
+#ifdef PANIS_PROFILER
+    if(bench) {
+        profiler_histograms_stop();
+        uint32_t elapsed = furi_get_tick() - bench_start;
+        bench_write_results(
+            storage,
+            BENCH_PATH,
+            bench_frames,
+            elapsed * 1000 / furi_kernel_get_tick_frequency(),
+            heap_free_min);
+    }
+#endif
+    if(state->replay != NULL || bench) {
+        if(state->replay != NULL) {
+            input_log_close(state->replay, state->steps);
+        }
+    } else {
+        // Save the progress for the next launch, a replay can be played again
+        game_save_progress(&state->game, progress);
+        resume_file_save(storage, RESUME_FILE_PATH, level_source, seed, progress);
+    }
+    furi_record_close(RECORD_STORAGE);
+    furi_message_queue_free(state->input_queue);
+    layer_cache_free(&state->layer);
+    asset_cache_free(state->assets);
+    arena_log_usage();
+    arena_reset(ArenaGame);
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// Built-in level compiled from levels/builtin.txt by tools/level_compiler.py
+// when the app is built. The data is const and stays in flash.
+//
+// Every chunk stores one bit plane per non-empty cell type: plane `t` holds
+// the cells of type `t + 1`, one byte per row with bit `c` set for column `c`.
+
+#define BUILTIN_LEVEL_ROWS 6
+#define BUILTIN_LEVEL_COLS 8  // Columns per chunk, one bit each
+#define BUILTIN_LEVEL_PLANES 5  // Cell types besides empty
+
+typedef struct {
+    uint8_t planes[BUILTIN_LEVEL_PLANES][BUILTIN_LEVEL_ROWS];
+} BuiltinChunk;
+
+typedef struct {
+    uint16_t num_chunks;
+    uint8_t num_tiles;
+    const uint8_t* tiles;  // Background image of each 128 px tile, repeated
+    const BuiltinChunk* chunks;
+    uint32_t id;  // CRC-32 of the tiles and chunks, for GameLevel.id
+} BuiltinLevel;
+
+extern const BuiltinLevel builtin_level;
@@ -0,0 +1,1213 @@
+#include "game.h"
+#include "builtin_level.h"
+
+#include <string.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CLAMP(x, upper, lower) (MIN(upper, ((x) > (lower) ? (x) : (lower))))
+
+// Bridge with diamonds on top, placed at fixed columns of the level
+#define BRIDGE_FIRST_COL 13
+#define BRIDGE_LAST_COL 17
+#define BRIDGE_ROW 3  // Two above ground
+
+// Grid generation percentages (as decimals)
+#define SKY_ROW_THRESHOLD 2         // Rows 0-1 are "sky" rows
+#define PERCENT_PILLS 0.02          // 2% pills
+#define PERCENT_AIR_BLOCKS 0.005    // 0.5% random air blocks
+#define PERCENT_GROUND_BLOCKS 0.02  // ~2% ground/stacked blocks
+#define PERCENT_CLOUDS 0.15         // 15% clouds in sky rows
+
+_Static_assert(MAX_ENTITIES <= 32, "Entity updates track the active slots in one word");
+_Static_assert(MAX_CHUNK_TOASTERS <= 8, "Defeated toasters are tracked in one byte per chunk");
+
+_Static_assert(
+    BUILTIN_LEVEL_ROWS == GRID_ROWS && BUILTIN_LEVEL_COLS == CHUNK_COLS,
+    "Built-in level chunks must match the grid chunks");
+
+// Entity configuration
+#define TOASTER_WIDTH 10
+#define TOASTER_HEIGHT 10
+#define TOASTER_SPEED 2          // Pixels per game step
+#define TOASTER_RELOAD_STEPS 20  // Game steps between two shots
+#define TOASTER_RANGE (SCREEN_WIDTH / 2)  // Shoots when Panis is this close
+#define CRUMB_SIZE 2
+#define CRUMB_SPEED 6
+#define STOMP_SCORE 50  // Score for jumping on a toaster
+#define STOMP_DEPTH 5   // Panis' feet must be at most this deep in the toaster
+
+// Behavior of each cell type
+const CellBehavior game_cell_behavior[CELL_TYPES] = {
+    [CELL_EMPTY] = {.collected = CELL_EMPTY},
+    [CELL_BLOCK] = {.solid = true, .collected = CELL_BLOCK},
+    [CELL_PILL] = {
+        .touch = CellTouchAlways,
+        .collected = CELL_EMPTY,
+        .score = 10,
+        .counter = CellCounterPill,
+        .event = GameEventChanged | GameEventPill,
+    },
+    [CELL_DIAMOND] = {.collected = CELL_DIAMOND},
+    [CELL_DIAMOND_FILLED] = {
+        .touch = CellTouchInAir,  // Emptied when jumping through it
+        .collected = CELL_DIAMOND,
+        .counter = CellCounterDiamond,
+        .event = GameEventChanged | GameEventDiamond,
+    },
+    [CELL_CLOUD] = {.collected = CELL_CLOUD},
+};
+
+static const uint8_t entity_width[] = {TOASTER_WIDTH, CRUMB_SIZE};
+static const uint8_t entity_height[] = {TOASTER_HEIGHT, CRUMB_SIZE};
+
+// Small, fast pseudo random number generator (xorshift32)
+typedef struct {
+    uint32_t state;
+} Rng;
+
+// Number of items with a given density per chunk that fall into a chunk.
+// Fractions carry over, so the whole level matches the density.
+static int chunk_share(int index, float per_chunk) {
+    return (int)((index + 1) * per_chunk) - (int)(index * per_chunk);
+}
+
+// Seed a generator. Any seed is fine, it is mixed so 0 and similar seeds work.
+static void rng_seed(Rng* rng, uint32_t seed) {
+    seed ^= seed >> 16;
+    seed *= 0x7FEB352DUL;
+    seed ^= seed >> 15;
+    seed *= 0x846CA68BUL;
+    seed ^= seed >> 16;
+    rng->state = seed ? seed : 0x9E3779B9UL;  // xorshift must not start at 0
+}
+
+static uint32_t rng_next(Rng* rng) {
+    uint32_t x = rng->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng->state = x;
+    return x;
+}
+
+// Random number in 0..n-1 (multiply-shift, no division)
+static uint32_t rng_below(Rng* rng, uint32_t n) {
+    return (uint32_t)(((uint64_t)rng_next(rng) * n) >> 32);
+}
+
+// List the empty cells of a chunk in rows first_row..last_row, as row * CHUNK_COLS + col
+static int list_empty_cells(const Chunk* chunk, int first_row, int last_row, uint8_t* cells) {
+    int count = 0;
+    for(int row = first_row; row <= last_row; row++) {
+        for(int col = 0; col < CHUNK_COLS; col++) {
+            if(chunk->cells[row][col] == CELL_EMPTY) {
+                cells[count++] = row * CHUNK_COLS + col;
+            }
+        }
+    }
+    return count;
+}
+
+// Move `count` random entries of a list to its front (partial Fisher-Yates
+// shuffle) and return how many there are
+static int pick_cells(Rng* rng, uint8_t* cells, int num_cells, int count) {
+    if(count > num_cells) {
+        count = num_cells;
+    }
+    for(int i = 0; i < count; i++) {
+        int j = i + rng_below(rng, num_cells - i);
+        uint8_t picked = cells[j];
+        cells[j] = cells[i];
+        cells[i] = picked;
+    }
+    return count;
+}
+
+// Number of solid cells stacked on the ground in a column of a chunk
+static int count_stacked(const Chunk* chunk, int col) {
+    int count = 0;
+    for(int row = GRID_ROWS - 1; row >= 0 && (chunk->solid[row] & (1 << col)); row--) {
+        count++;
+    }
+    return count;
+}
+
+// Write a cell of a chunk, the only place chunk cells change. The content
+// counters and the collision masks follow the cells, so they never drift.
+static void chunk_set_cell(Chunk* chunk, int row, int col, uint8_t cell) {
+    const CellBehavior* before = &game_cell_behavior[chunk->cells[row][col]];
+    const CellBehavior* after = &game_cell_behavior[cell];
+    chunk->ground_blocks -= count_stacked(chunk, col);
+    if(after->solid) {
+        chunk->solid[row] |= 1 << col;
+    } else {
+        chunk->solid[row] &= ~(1 << col);
+    }
+    chunk->ground_blocks += count_stacked(chunk, col);
+    chunk->blocks += after->solid - before->solid;
+    chunk->pills += (after->counter == CellCounterPill) - (before->counter == CellCounterPill);
+    chunk->diamonds +=
+        (after->counter == CellCounterDiamond) - (before->counter == CellCounterDiamond);
+    chunk->cells[row][col] = cell;
+}
+
+// Generate the cells of a chunk. The result depends only on seed and index,
+// so a chunk that scrolled out of range is rebuilt identically. Every step
+// samples from the cells still free, so generation never has to retry.
+static void generate_chunk(uint32_t seed, int index, Chunk* chunk) {
+    memset(chunk, 0, sizeof(Chunk));
+    chunk->index = index;
+    Rng rng;
+    rng_seed(&rng, seed ^ ((uint32_t)index * 2654435761UL));
+    
+    int total_cells = GRID_ROWS * CHUNK_COLS;
+    int num_pills = chunk_share(index, total_cells * PERCENT_PILLS);
+    int num_air_blocks = chunk_share(index, total_cells * PERCENT_AIR_BLOCKS);
+    int num_ground_blocks = chunk_share(index, total_cells * PERCENT_GROUND_BLOCKS);
+    int sky_cells = SKY_ROW_THRESHOLD * CHUNK_COLS;
+    int num_clouds = chunk_share(index, sky_cells * PERCENT_CLOUDS);
+    uint8_t free_cells[GRID_ROWS * CHUNK_COLS];
+    int num_free;
+    
+    // Place clouds in sky rows only (rows 0-1)
+    num_free = list_empty_cells(chunk, 0, SKY_ROW_THRESHOLD - 1, free_cells);
+    num_clouds = pick_cells(&rng, free_cells, num_free, num_clouds);
+    for(int i = 0; i < num_clouds; i++) {
+        chunk_set_cell(chunk, free_cells[i] / CHUNK_COLS, free_cells[i] % CHUNK_COLS, CELL_CLOUD);
+    }
+    
+    // Place air blocks (random positions in rows 0-4)
+    num_free = list_empty_cells(chunk, 0, GRID_ROWS - 2, free_cells);
+    num_air_blocks = pick_cells(&rng, free_cells, num_free, num_air_blocks);
+    for(int i = 0; i < num_air_blocks; i++) {
+        chunk_set_cell(chunk, free_cells[i] / CHUNK_COLS, free_cells[i] % CHUNK_COLS, CELL_BLOCK);
+    }
+    
+    // Place ground blocks (on row 5 or stacked)
+    for(int i = 0; i < num_ground_blocks; i++) {
+        int col = rng_below(&rng, CHUNK_COLS);
+        // Find lowest empty cell in this column
+        for(int row = GRID_ROWS - 1; row >= 0; row--) {
+            if(chunk->cells[row][col] == CELL_EMPTY) {
+                chunk_set_cell(chunk, row, col, CELL_BLOCK);
+                break;
+            }
+        }
+    }
+    
+    // Place pills in empty cells
+    num_free = list_empty_cells(chunk, 0, GRID_ROWS - 1, free_cells);
+    num_pills = pick_cells(&rng, free_cells, num_free, num_pills);
+    for(int i = 0; i < num_pills; i++) {
+        chunk_set_cell(chunk, free_cells[i] / CHUNK_COLS, free_cells[i] % CHUNK_COLS, CELL_PILL);
+    }
+    
+    // Create bridge on the bridge columns of this chunk
+    for(int col = 0; col < CHUNK_COLS; col++) {
+        int level_col = index * CHUNK_COLS + col;
+        if(level_col < BRIDGE_FIRST_COL || level_col > BRIDGE_LAST_COL) {
+            continue;
+        }
+        // First clear any blocks underneath the bridge
+        for(int row = BRIDGE_ROW + 1; row < GRID_ROWS; row++) {
+            chunk_set_cell(chunk, row, col, CELL_EMPTY);
+        }
+        // Place bridge block
+        chunk_set_cell(chunk, BRIDGE_ROW, col, CELL_BLOCK);
+        // Place diamond on top of bridge
+        chunk_set_cell(chunk, BRIDGE_ROW - 1, col, CELL_DIAMOND_FILLED);
+    }
+    
+    // Place diamonds below pills in sky rows (0-1)
+    for(int row = 0; row < SKY_ROW_THRESHOLD; row++) {
+        for(int col = 0; col < CHUNK_COLS; col++) {
+            if(chunk->cells[row][col] == CELL_PILL) {
+                // Place diamond in cell below if empty
+                int below_row = row + 1;
+                if(below_row < GRID_ROWS && chunk->cells[below_row][col] == CELL_EMPTY) {
+                    chunk_set_cell(chunk, below_row, col, CELL_DIAMOND_FILLED);
+                }
+            }
+        }
+    }
+}
+
+// Read a chunk of a stored level into an empty chunk, it stays empty if the
+// chunk can't be read
+static void read_chunk(const GameLevel* level, int index, Chunk* chunk) {
+    uint8_t cells[GRID_ROWS * CHUNK_COLS];
+    if(!level->read_chunk(level->context, index, cells)) {
+        return;
+    }
+    for(int row = 0; row < GRID_ROWS; row++) {
+        for(int col = 0; col < CHUNK_COLS; col++) {
+            uint8_t cell = cells[row * CHUNK_COLS + col];
+            if(cell < CELL_TYPES) {  // Unknown cell types stay empty
+                chunk_set_cell(chunk, row, col, cell);
+            }
+        }
+    }
+}
+
+// Unpack a chunk of the built-in level from its per cell type bit planes
+bool game_read_builtin_chunk(void* context, uint16_t index, uint8_t* cells) {
+    const BuiltinLevel* level = context;
+    if(index >= level->num_chunks) {
+        memset(cells, CELL_EMPTY, GRID_ROWS * CHUNK_COLS);
+        return false;
+    }
+    const BuiltinChunk* source = &level->chunks[index];
+    for(int row = 0; row < GRID_ROWS; row++) {
+        for(int col = 0; col < CHUNK_COLS; col++) {
+            uint8_t cell = CELL_EMPTY;
+            for(int plane = 0; plane < BUILTIN_LEVEL_PLANES; plane++) {
+                if(source->planes[plane][row] & (1 << col)) {
+                    cell = plane + 1;
+                }
+            }
+            cells[row * CHUNK_COLS + col] = cell;
+        }
+    }
+    return true;
+}
+
+// Get a loaded chunk, NULL if it isn't in memory
+static const Chunk* get_chunk(const Game* game, int index) {
+    if(index < 0 || index >= game->level_chunks) {
+        return NULL;
+    }
+    const Chunk* chunk = game->chunks[index % RING_CHUNKS];
+    return (chunk->index == index) ? chunk : NULL;
+}
+
+// The chunk's base cell with the collected overlay applied
+uint8_t game_get_cell(const Game* game, int row, int col) {
+    if(row < 0 || row >= GRID_ROWS || col < 0) {
+        return CELL_EMPTY;
+    }
+    const Chunk* chunk = get_chunk(game, col / CHUNK_COLS);
+    if(chunk == NULL) {
+        return CELL_EMPTY;
+    }
+    uint8_t cell = chunk->cells[row][col % CHUNK_COLS];
+    if(game->collected[chunk->index] & (1ULL << (row * CHUNK_COLS + col % CHUNK_COLS))) {
+        cell = game_cell_behavior[cell].collected;
+    }
+    return cell;
+}
+
+// Convert a world pixel coordinate to a grid cell index (rounds down, also
+// for coordinates above the top of the grid)
+static int pixel_to_cell(int px) {
+    return (px >= 0) ? px / CELL_SIZE : -((CELL_SIZE - 1 - px) / CELL_SIZE);
+}
+
+// Check if there is a block in a row between two columns (inclusive)
+static bool row_has_block(Game* game, int row, int col_start, int col_end) {
+    if(row < 0 || row >= GRID_ROWS) {
+        return false;
+    }
+    if(col_start < 0) col_start = 0;
+    if(col_end >= game->level_cols) col_end = game->level_cols - 1;
+    
+    // Test the part of the span in each chunk with one mask
+    while(col_start <= col_end) {
+        int index = col_start / CHUNK_COLS;
+        int first = col_start % CHUNK_COLS;
+        int last = MIN(col_end - index * CHUNK_COLS, CHUNK_COLS - 1);
+        const Chunk* chunk = get_chunk(game, index);
+        if(chunk != NULL) {
+            uint8_t span = (0xFF >> (CHUNK_COLS - 1 - (last - first))) << first;
+            if(chunk->solid[row] & span) {
+                return true;
+            }
+        }
+        col_start = (index + 1) * CHUNK_COLS;
+    }
+    return false;
+}
+
+// Check if a box (the character or an entity of at most one cell height)
+// collides with a block at given position
+static bool check_block_collision(Game* game, int world_x, int y_pos, int width, int height) {
+    // Columns and rows covered by the box
+    int col_start = pixel_to_cell(world_x);
+    int col_end = pixel_to_cell(world_x + width - 1);
+    int top_row = pixel_to_cell(y_pos);
+    int bottom_row = pixel_to_cell(y_pos + height - 1);
+    
+    return row_has_block(game, top_row, col_start, col_end) ||
+           row_has_block(game, bottom_row, col_start, col_end);
+}
+
+// Sweep a box vertically from y_from to y_to and return the first row with
+// a block in its way, or -1 if nothing blocks the movement. Every row
+// between both positions is checked, so fast moves can't tunnel.
+static int sweep_vertical(Game* game, int world_x, int width, int height, int y_from, int y_to) {
+    int col_start = pixel_to_cell(world_x);
+    int col_end = pixel_to_cell(world_x + width - 1);
+    
+    if(y_to > y_from) {
+        // Moving down: rows newly entered by the bottom edge
+        int first_row = pixel_to_cell(y_from + height - 1) + 1;
+        int last_row = pixel_to_cell(y_to + height - 1);
+        for(int row = first_row; row <= last_row; row++) {
+            if(row_has_block(game, row, col_start, col_end)) {
+                return row;
+            }
+        }
+    } else if(y_to < y_from) {
+        // Moving up: rows newly entered by the top edge
+        int first_row = pixel_to_cell(y_from) - 1;
+        int last_row = pixel_to_cell(y_to);
+        for(int row = first_row; row >= last_row; row--) {
+            if(row_has_block(game, row, col_start, col_end)) {
+                return row;
+            }
+        }
+    }
+    return -1;
+}
+
+// Check if a box can stand on a block
+static bool check_ground_support(Game* game, int world_x, int y_pos, int width, int height) {
+    // Check one pixel below the box
+    int feet_row = pixel_to_cell(y_pos + height);
+    int col_start = pixel_to_cell(world_x);
+    int col_end = pixel_to_cell(world_x + width - 1);
+    
+    return row_has_block(game, feet_row, col_start, col_end);
+}
+
+// Bucket of a grid column
+static int column_bucket(int col) {
+    col %= ENTITY_BUCKETS;
+    return (col < 0) ? col + ENTITY_BUCKETS : col;
+}
+
+// Bucket of the grid column a world X position is in
+static int entity_bucket(int x) {
+    return column_bucket(pixel_to_cell(x));
+}
+
+// Empty the entity pool
+static void entities_reset(Entities* entities) {
+    for(int i = 0; i < MAX_ENTITIES; i++) {
+        entities->flags[i] = 0;
+        entities->next[i] = (i + 1 < MAX_ENTITIES) ? i + 1 : ENTITY_NONE;
+    }
+    memset(entities->bucket, ENTITY_NONE, sizeof(entities->bucket));
+    entities->free = 0;
+    entities->count = 0;
+}
+
+static void link_entity(Entities* entities, uint8_t entity) {
+    int bucket = entity_bucket(entities->x[entity]);
+    entities->next[entity] = entities->bucket[bucket];
+    entities->bucket[bucket] = entity;
+}
+
+static void unlink_entity(Entities* entities, uint8_t entity) {
+    uint8_t* link = &entities->bucket[entity_bucket(entities->x[entity])];
+    while(*link != entity) {
+        link = &entities->next[*link];
+    }
+    *link = entities->next[entity];
+}
+
+// Take an entity from the pool, ENTITY_NONE if it is exhausted
+static uint8_t spawn_entity(Game* game, EntityType type, int x, int y, int vx, int home) {
+    Entities* entities = &game->entities;
+    uint8_t entity = entities->free;
+    if(entity == ENTITY_NONE) {
+        return ENTITY_NONE;
+    }
+    entities->free = entities->next[entity];
+    entities->count++;
+    entities->x[entity] = x;
+    entities->y[entity] = y;
+    entities->vx[entity] = vx;
+    entities->vy[entity] = 0;
+    entities->type[entity] = type;
+    entities->flags[entity] = ENTITY_ACTIVE;
+    entities->timer[entity] = TOASTER_RELOAD_STEPS;
+    entities->home[entity] = home;
+    entities->spawn[entity] = 0;
+    link_entity(entities, entity);
+    return entity;
+}
+
+// Put an entity back into the pool
+static void despawn_entity(Game* game, uint8_t entity) {
+    Entities* entities = &game->entities;
+    unlink_entity(entities, entity);
+    entities->flags[entity] = 0;
+    entities->next[entity] = entities->free;
+    entities->free = entity;
+    entities->count--;
+}
+
+// Move an entity horizontally, keeping its bucket up to date
+static void move_entity(Entities* entities, uint8_t entity, int x) {
+    if(entity_bucket(x) != entity_bucket(entities->x[entity])) {
+        unlink_entity(entities, entity);
+        entities->x[entity] = x;
+        link_entity(entities, entity);
+    } else {
+        entities->x[entity] = x;
+    }
+}
+
+// Place the toasters of a chunk, standing on the ground or the highest block
+// of a random column. Depends only on seed and index like the chunk itself.
+// Defeated toasters are skipped, the others keep their places.
+static void spawn_chunk_entities(Game* game, const Chunk* chunk) {
+    int index = chunk->index;
+    if(index == 0) {
+        return;  // No toaster at the start
+    }
+    Rng rng;
+    rng_seed(&rng, game->level_seed ^ ((uint32_t)index * 0x9E3779B1UL) ^ 0x70A57E4UL);
+    int toasters = MIN(game->level.toasters_per_chunk, MAX_CHUNK_TOASTERS);
+    if(toasters == 0) {
+        toasters = rng_below(&rng, 2);  // Usually a toaster in every other chunk
+    }
+    for(int i = 0; i < toasters; i++) {
+        int x = (index * CHUNK_COLS + rng_below(&rng, CHUNK_COLS)) * CELL_SIZE;
+        int vx = rng_below(&rng, 2) ? TOASTER_SPEED : -TOASTER_SPEED;
+        if(game->chunk_defeated[index] & (1 << i)) {
+            continue;
+        }
+        int y = GROUND_Y - TOASTER_HEIGHT;
+        int hit_row = sweep_vertical(game, x, TOASTER_WIDTH, TOASTER_HEIGHT, -TOASTER_HEIGHT, y);
+        if(hit_row >= 0) {
+            y = hit_row * CELL_SIZE - TOASTER_HEIGHT;
+        }
+        uint8_t entity = spawn_entity(game, EntityToaster, x, y, vx, index);
+        if(entity != ENTITY_NONE) {
+            game->entities.spawn[entity] = i;
+        }
+    }
+}
+
+// Remove the entities of chunk `index` (-1 for none) and the ones outside
+// the loaded range
+static void despawn_chunk_entities(Game* game, int index) {
+    Entities* entities = &game->entities;
+    int first_x = game->first_chunk * CHUNK_WIDTH;
+    int end_x = (game->first_chunk + RING_CHUNKS) * CHUNK_WIDTH;
+    for(int entity = 0; entity < MAX_ENTITIES; entity++) {
+        if(!(entities->flags[entity] & ENTITY_ACTIVE)) {
+            continue;
+        }
+        int x = entities->x[entity];
+        if(entities->home[entity] == index || x < first_x || x >= end_x) {
+            despawn_entity(game, entity);
+        }
+    }
+}
+
+// Include the content of a chunk in the counters, once per level
+static void count_chunk_once(Game* game, const Chunk* chunk) {
+    int index = chunk->index;
+    uint8_t counted_bit = 1 << (index % 8);
+    if(!(game->chunk_counted[index / 8] & counted_bit)) {
+        game->chunk_counted[index / 8] |= counted_bit;
+        game->block_count += chunk->blocks;
+        game->ground_blocks += chunk->ground_blocks;
+        game->pill_count += chunk->pills;
+        game->overall_pills += chunk->pills;
+        game->overall_diamonds += chunk->diamonds;
+        game->events |= GameEventChanged;
+    }
+}
+
+void game_build_chunk(const GameLevel* level, uint32_t seed, int index, Chunk* chunk) {
+    if(level->num_chunks > 0) {
+        memset(chunk, 0, sizeof(Chunk));
+        chunk->index = index;
+        read_chunk(level, index, chunk);
+    } else {
+        generate_chunk(seed, index, chunk);
+    }
+}
+
+// Load a chunk into its ring slot: swap in the spare if it was prefetched,
+// else generate or read it now
+static void load_chunk(Game* game, int index) {
+    Chunk** slot = &game->chunks[index % RING_CHUNKS];
+    Chunk* chunk = *slot;
+    if(chunk->index >= 0) {
+        despawn_chunk_entities(game, chunk->index);
+    }
+    if(game->spare != NULL && game->spare->index == index) {
+        *slot = game->spare;
+        game->spare = chunk;
+        chunk->index = -1;
+        chunk = *slot;
+    } else {
+        game_build_chunk(&game->level, game->level_seed, index, chunk);
+    }
+    
+    // Count the content of each chunk on its first visit
+    count_chunk_once(game, chunk);
+    game->journal.rescan = true;  // All its cells changed
+    spawn_chunk_entities(game, chunk);
+}
+
+// Keep the chunks around the camera loaded, drop the ones out of range
+static void stream_chunks(Game* game) {
+    int first_chunk = game->camera_x / CHUNK_WIDTH - 1;
+    if(first_chunk == game->first_chunk) {
+        return;
+    }
+    game->first_chunk = first_chunk;
+    despawn_chunk_entities(game, -1);
+    for(int index = first_chunk; index < first_chunk + RING_CHUNKS; index++) {
+        if(index >= 0 && index < game->level_chunks && get_chunk(game, index) == NULL) {
+            load_chunk(game, index);
+        }
+    }
+}
+
+// Put the character on a whole pixel row
+static void set_character_y(Game* game, int y_pos) {
+    game->y_fixed = TO_FIXED(y_pos);
+    game->y_pos = y_pos;
+}
+
+// Put the character back to the start position
+static void reset_character(Game* game) {
+    game->world_x = CHAR_START_X;  // Start at 1/4 of screen width
+    game->screen_x = CHAR_START_X;
+    game->camera_x = 0;
+    game->facing_right = true;
+    game->x_fraction = 0;
+    set_character_y(game, GROUND_Y - CHAR_HEIGHT);
+    game->y_velocity = 0;
+    game->on_ground = true;
+    game->last_jump_time = 0;
+    game->has_jumped = false;
+}
+
+// Forget everything collected in the level and reset the counters. Defeated
+// toasters stay defeated, only a new level brings them back.
+static void reset_progress(Game* game) {
+    game->score = 0;
+    game->block_count = 0;
+    game->pill_count = 0;
+    game->overall_pills = 0;
+    game->overall_diamonds = 0;
+    game->filled_diamonds = 0;
+    game->ground_blocks = 0;
+    memset(game->collected, 0, sizeof(game->collected));
+    memset(game->chunk_counted, 0, sizeof(game->chunk_counted));
+    entities_reset(&game->entities);
+}
+
+// Set up the level size and background for the stored level if given, else
+// a generated one
+static void setup_level(Game* game, const GameLevel* level, uint32_t seed) {
+    game->level_seed = seed;
+    game->events = GameEventChanged;
+    
+    // Level size and background
+    if(level != NULL && level->num_chunks > 0) {
+        game->level = *level;
+        game->level_chunks = CLAMP(level->num_chunks, MAX_LEVEL_CHUNKS, MIN_LEVEL_CHUNKS);
+    } else {
+        memset(&game->level, 0, sizeof(GameLevel));
+        game->level.id = GAME_GENERATOR_ID;
+        game->level_chunks = LEVEL_CHUNKS;
+    }
+    game->level_cols = game->level_chunks * CHUNK_COLS;
+    game->map_width = game->level_cols * CELL_SIZE;
+    for(int i = 0; i < MAX_LEVEL_TILES; i++) {
+        bool stored = game->level.num_tiles > 0;
+        game->tiles[i] = stored ? game->level.tiles[i % game->level.num_tiles] : i;
+    }
+}
+
+// Drop all loaded chunks and the spare, then load the chunks around the camera
+static void reload_chunks(Game* game) {
+    for(int i = 0; i < RING_CHUNKS; i++) {
+        game->chunks[i] = &game->chunk_store[i];
+        game->chunks[i]->index = -1;
+    }
+    game->spare = &game->chunk_store[RING_CHUNKS];
+    game->spare->index = -1;
+    game->first_chunk = INT32_MIN;
+    stream_chunks(game);
+    
+    // All blocks and clouds changed, whatever was drawn of the last level
+    for(int index = 0; index < MAX_LEVEL_CHUNKS; index++) {
+        game->chunk_version[index]++;
+    }
+}
+
+// Start a new level: the stored level if given, else generated from the seed
+void game_init(Game* game, const GameLevel* level, uint32_t seed) {
+    reset_character(game);
+    setup_level(game, level, seed);
+    reset_progress(game);
+    memset(game->chunk_defeated, 0, sizeof(game->chunk_defeated));
+    reload_chunks(game);
+}
+
+bool game_resume(Game* game, const GameLevel* level, uint32_t seed, const GameProgress* progress) {
+    setup_level(game, level, seed);
+    
+    // The character must be within the level and the view
+    int max_camera_x = game->map_width - SCREEN_WIDTH;
+    if(progress->level_chunks != game->level_chunks || progress->level_id != game->level.id ||
+       progress->camera_x < 0 || progress->camera_x > max_camera_x || progress->screen_x < 0 ||
+       progress->screen_x > SCREEN_WIDTH - CHAR_WIDTH ||
+       progress->world_x != progress->camera_x + progress->screen_x ||
+       progress->x_fraction < 0 || progress->x_fraction >= FIXED_ONE ||
+       FIXED_TO_PIXEL(progress->y_fixed) < GROUND_Y - CHAR_HEIGHT - MAX_JUMP_HEIGHT ||
+       FIXED_TO_PIXEL(progress->y_fixed) > GROUND_Y - CHAR_HEIGHT) {
+        return false;
+    }
+    
+    game->world_x = progress->world_x;
+    game->x_fraction = progress->x_fraction;
+    game->screen_x = progress->screen_x;
+    game->camera_x = progress->camera_x;
+    game->facing_right = progress->facing_right;
+    game->y_fixed = progress->y_fixed;
+    game->y_pos = FIXED_TO_PIXEL(progress->y_fixed);
+    game->y_velocity = progress->y_velocity;
+    game->on_ground = progress->on_ground;
+    game->last_jump_time = 0;
+    game->has_jumped = false;
+    game->score = progress->score;
+    game->block_count = progress->block_count;
+    game->pill_count = progress->pill_count;
+    game->overall_pills = progress->overall_pills;
+    game->overall_diamonds = progress->overall_diamonds;
+    game->filled_diamonds = progress->filled_diamonds;
+    game->ground_blocks = progress->ground_blocks;
+    memcpy(game->chunk_counted, progress->chunk_counted, sizeof(game->chunk_counted));
+    memcpy(game->chunk_defeated, progress->chunk_defeated, sizeof(game->chunk_defeated));
+    memcpy(game->collected, progress->collected, sizeof(game->collected));
+    
+    // Chunks already counted are not counted again while loading
+    entities_reset(&game->entities);
+    reload_chunks(game);
+    return true;
+}
+
+void game_save_progress(const Game* game, GameProgress* progress) {
+    memset(progress, 0, sizeof(GameProgress));
+    progress->level_chunks = game->level_chunks;
+    progress->level_id = game->level.id;
+    progress->facing_right = game->facing_right;
+    progress->on_ground = game->on_ground;
+    progress->world_x = game->world_x;
+    progress->x_fraction = game->x_fraction;
+    progress->screen_x = game->screen_x;
+    progress->camera_x = game->camera_x;
+    progress->y_fixed = game->y_fixed;
+    progress->y_velocity = game->y_velocity;
+    progress->score = game->score;
+    progress->block_count = game->block_count;
+    progress->pill_count = game->pill_count;
+    progress->overall_pills = game->overall_pills;
+    progress->overall_diamonds = game->overall_diamonds;
+    progress->filled_diamonds = game->filled_diamonds;
+    progress->ground_blocks = game->ground_blocks;
+    memcpy(progress->chunk_counted, game->chunk_counted, sizeof(progress->chunk_counted));
+    memcpy(progress->chunk_defeated, game->chunk_defeated, sizeof(progress->chunk_defeated));
+    memcpy(progress->collected, game->collected, sizeof(progress->collected));
+}
+
+// Restart the current level. The chunks are immutable, so only the overlay
+// and counters are cleared; loaded chunks near the start are kept.
+void game_restart(Game* game) {
+    reset_progress(game);
+    reset_character(game);
+    int first_chunk = game->camera_x / CHUNK_WIDTH - 1;
+    for(int i = 0; i < RING_CHUNKS; i++) {
+        Chunk* chunk = game->chunks[i];
+        if(chunk->index >= 0 && chunk->index >= first_chunk &&
+           chunk->index < first_chunk + RING_CHUNKS) {
+            count_chunk_once(game, chunk);
+            spawn_chunk_entities(game, chunk);
+        } else {
+            chunk->index = -1;
+        }
+    }
+    game->first_chunk = INT32_MIN;
+    stream_chunks(game);
+    game->events |= GameEventChanged;
+}
+
+// Collect a cell: the only place the cells change after loading. Marks it
+// in the overlay, updates the counters and notes it in the change journal.
+static void collect_cell(Game* game, int row, int col, uint8_t cell) {
+    const CellBehavior* behavior = &game_cell_behavior[cell];
+    int bit = row * CHUNK_COLS + col % CHUNK_COLS;
+    game->collected[col / CHUNK_COLS] |= 1ULL << bit;
+    game->score += behavior->score;
+    if(behavior->counter == CellCounterPill) game->pill_count--;
+    if(behavior->counter == CellCounterDiamond) game->filled_diamonds++;
+    game->events |= behavior->event;
+    
+    CellJournal* journal = &game->journal;
+    if(journal->count < CELL_JOURNAL_SIZE) {
+        CellChange* change = &journal->changes[journal->count++];
+        change->col = col;
+        change->row = row;
+        change->cell = behavior->collected;
+    } else {
+        journal->rescan = true;
+    }
+}
+
+// Collect pills and activate diamonds at the character position, one pass
+// over the overlapped cells
+void game_collect_pills(Game* game) {
+    int left = game->world_x;
+    int right = game->world_x + CHAR_WIDTH - 1;
+    int top = game->y_pos;
+    int bottom = game->y_pos + CHAR_HEIGHT - 1;
+    
+    // Check cells that character overlaps
+    int col_start = pixel_to_cell(left);
+    int col_end = pixel_to_cell(right);
+    int row_start = pixel_to_cell(top);
+    int row_end = pixel_to_cell(bottom);
+    
+    for(int row = row_start; row <= row_end; row++) {
+        for(int col = col_start; col <= col_end; col++) {
+            uint8_t cell = game_get_cell(game, row, col);
+            uint8_t touch = game_cell_behavior[cell].touch;
+            if(touch == CellTouchAlways || (touch == CellTouchInAir && !game->on_ground)) {
+                collect_cell(game, row, col, cell);
+            }
+        }
+    }
+}
+
+// Apply gravity and update Y position for one physics update. Velocities
+// are per game step, so each update applies a GAME_SUBSTEPS part of them.
+void game_update_physics(Game* game) {
+    int old_y_pos = game->y_pos;
+    
+    // Apply gravity
+    if(!game->on_ground) {
+        game->y_velocity += TO_FIXED(GRAVITY) / GAME_SUBSTEPS;
+        if(game->y_velocity > TO_FIXED(MAX_FALL_SPEED)) {
+            game->y_velocity = TO_FIXED(MAX_FALL_SPEED);
+        }
+    }
+    
+    // Try to update Y position
+    int32_t new_y_fixed = game->y_fixed + game->y_velocity / GAME_SUBSTEPS;
+    int new_y = FIXED_TO_PIXEL(new_y_fixed);
+    
+    // Limit maximum jump height
+    int max_height_y = GROUND_Y - CHAR_HEIGHT - MAX_JUMP_HEIGHT;
+    if(new_y < max_height_y) {
+        new_y_fixed = TO_FIXED(max_height_y);
+        new_y = max_height_y;
+        game->y_velocity = 0;  // Stop upward movement
+    }
+    
+    // Check collision with blocks along the whole way
+    int hit_row = sweep_vertical(game, game->world_x, CHAR_WIDTH, CHAR_HEIGHT, game->y_pos, new_y);
+    if(hit_row >= 0) {
+        if(new_y > game->y_pos) {
+            // Land on top of the block
+            new_y = hit_row * CELL_SIZE - CHAR_HEIGHT;
+        } else {
+            // Bump the head against the block
+            new_y = (hit_row + 1) * CELL_SIZE;
+            game->events |= GameEventBump;
+        }
+        new_y_fixed = TO_FIXED(new_y);
+        game->y_velocity = 0;
+    }
+    
+    game->y_fixed = new_y_fixed;
+    game->y_pos = new_y;
+    
+    // Ground collision
+    int ground_pos = GROUND_Y - CHAR_HEIGHT;
+    if(game->y_pos >= ground_pos) {
+        set_character_y(game, ground_pos);
+        game->y_velocity = 0;
+        game->on_ground = true;
+    } else if(game->y_velocity >= 0 && check_ground_support(game, game->world_x, game->y_pos, CHAR_WIDTH, CHAR_HEIGHT)) {
+        // Standing on a block
+        set_character_y(game, game->y_pos);
+        game->y_velocity = 0;
+        game->on_ground = true;
+    } else {
+        game->on_ground = false;
+    }
+    if(game->y_pos != old_y_pos) {
+        game->events |= GameEventChanged;
+    }
+}
+
+// Handle jump input
+void game_jump(Game* game, uint32_t now) {
+    if(game->on_ground) {
+        // The clock of the caller may start anywhere, the first press is
+        // never the second half of a double click
+        bool is_double_click = game->has_jumped && (now - game->last_jump_time) < DOUBLE_CLICK_MS;
+        
+        // Double-click = big jump, single click = small jump
+        game->y_velocity = TO_FIXED(is_double_click ? BIG_JUMP_VELOCITY : SMALL_JUMP_VELOCITY);
+        
+        game->last_jump_time = now;
+        game->has_jumped = true;
+        game->on_ground = false;
+    }
+}
+
+// Update horizontal movement logic
+void game_move(Game* game, GameDirection direction) {
+    // Whole pixels walked in this update, the rest is kept for the next one
+    int distance = game->x_fraction + TO_FIXED(MOVEMENT_SPEED) / GAME_SUBSTEPS;
+    int speed = FIXED_TO_PIXEL(distance);
+    game->x_fraction = distance & (FIXED_ONE - 1);
+    
+    int old_world_x = game->world_x;
+    int new_world_x = game->world_x;
+    int new_screen_x = game->screen_x;
+    int new_camera_x = game->camera_x;
+    
+    if(direction == GameDirectionRight) {
+        if(!game->facing_right) {
+            game->facing_right = true;
+            game->events |= GameEventChanged;
+        }
+        
+        // Check if we can move right
+        if(speed > 0 && game->world_x < game->map_width - CHAR_WIDTH) {
+            // Calculate new position
+            new_world_x = game->world_x + speed;
+            
+            // Check for block collision
+            if(check_block_collision(game, new_world_x, game->y_pos, CHAR_WIDTH, CHAR_HEIGHT)) {
+                game->x_fraction = 0;
+                game->events |= GameEventBump;
+                return;
+            }
+            
+            // Determine if we should scroll or move character
+            if(game->screen_x >= START_SCROLL_X && 
+               game->camera_x < game->map_width - SCREEN_WIDTH) {
+                // Scroll the world
+                new_camera_x = game->camera_x + speed;
+                
+                // Clamp camera
+                if(new_camera_x > game->map_width - SCREEN_WIDTH) {
+                    int overflow = new_camera_x - (game->map_width - SCREEN_WIDTH);
+                    new_camera_x = game->map_width - SCREEN_WIDTH;
+                    new_screen_x = game->screen_x + overflow;
+                } else {
+                    new_screen_x = game->screen_x;
+                }
+            } else {
+                // Move character on screen
+                new_screen_x = game->screen_x + speed;
+                new_camera_x = game->camera_x;
+                
+                // Clamp to screen edge
+                if(new_screen_x > SCREEN_WIDTH - CHAR_WIDTH) {
+                    new_screen_x = SCREEN_WIDTH - CHAR_WIDTH;
+                }
+            }
+            
+            // Clamp world position
+            if(new_world_x > game->map_width - CHAR_WIDTH) {
+                new_world_x = game->map_width - CHAR_WIDTH;
+            }
+            
+            game->world_x = new_world_x;
+            game->screen_x = new_screen_x;
+            game->camera_x = new_camera_x;
+            game->events |= GameEventChanged;
+            stream_chunks(game);
+        }
+    } else if(direction == GameDirectionLeft) {
+        if(game->facing_right) {
+            game->facing_right = false;
+            game->events |= GameEventChanged;
+        }
+        
+        // Check if we can move left
+        if(speed > 0 && game->world_x > 0) {
+            // Calculate new position
+            new_world_x = game->world_x - speed;
+            
+            // Check for block collision
+            if(check_block_collision(game, new_world_x, game->y_pos, CHAR_WIDTH, CHAR_HEIGHT)) {
+                game->x_fraction = 0;
+                game->events |= GameEventBump;
+                return;
+            }
+            
+            // Determine if we should scroll or move character
+            if(game->screen_x <= START_SCROLL_X && game->camera_x > 0) {
+                // Scroll the world (move camera left)
+                new_camera_x = game->camera_x - speed;
+                
+                // Clamp camera
+                if(new_camera_x < 0) {
+                    int overflow = -new_camera_x;
+                    new_camera_x = 0;
+                    new_screen_x = game->screen_x - overflow;
+                } else {
+                    new_screen_x = game->screen_x;
+                }
+            } else {
+                // Move character on screen
+                new_screen_x = game->screen_x - speed;
+                new_camera_x = game->camera_x;
+                
+                // Clamp to screen edge
+                if(new_screen_x < 0) {
+                    new_screen_x = 0;
+                }
+            }
+            
+            // Clamp world position
+            if(new_world_x < 0) {
+                new_world_x = 0;
+            }
+            
+            game->world_x = new_world_x;
+            game->screen_x = new_screen_x;
+            game->camera_x = new_camera_x;
+            game->events |= GameEventChanged;
+            stream_chunks(game);
+        }
+    }
+    
+    // Vibrate if we hit a boundary
+    if((old_world_x != game->world_x) && 
+       (game->world_x == 0 || game->world_x == game->map_width - CHAR_WIDTH)) {
+        game->events |= GameEventBump;
+    }
+}
+
+
+// Check if two boxes overlap
+static bool boxes_overlap(int x1, int y1, int w1, int h1, int x2, int y2, int w2, int h2) {
+    return x1 < x2 + w2 && x2 < x1 + w1 && y1 < y2 + h2 && y2 < y1 + h1;
+}
+
+// World X range entities can move in: the loaded chunks within the level
+static void get_entity_range(const Game* game, int* first_x, int* end_x) {
+    *first_x = MAX(game->first_chunk * CHUNK_WIDTH, 0);
+    *end_x = MIN((game->first_chunk + RING_CHUNKS) * CHUNK_WIDTH, game->map_width);
+}
+
+// Walk, fall, turn at blocks and shoot at Panis when close
+static void update_toaster(Game* game, uint8_t entity) {
+    Entities* entities = &game->entities;
+    int x = entities->x[entity];
+    int y = entities->y[entity];
+    
+    // Turn around at blocks and at the end of the loaded range
+    int first_x, end_x;
+    get_entity_range(game, &first_x, &end_x);
+    int new_x = x + entities->vx[entity];
+    if(new_x < first_x || new_x > end_x - TOASTER_WIDTH ||
+       check_block_collision(game, new_x, y, TOASTER_WIDTH, TOASTER_HEIGHT)) {
+        entities->vx[entity] = -entities->vx[entity];
+    } else {
+        move_entity(entities, entity, new_x);
+    }
+    
+    // Fall like Panis does
+    x = entities->x[entity];
+    if(!(entities->flags[entity] & ENTITY_ON_GROUND)) {
+        entities->vy[entity] = MIN(entities->vy[entity] + GRAVITY, MAX_FALL_SPEED);
+    }
+    int new_y = y + entities->vy[entity];
+    int hit_row = sweep_vertical(game, x, TOASTER_WIDTH, TOASTER_HEIGHT, y, new_y);
+    if(hit_row >= 0) {
+        new_y = hit_row * CELL_SIZE - TOASTER_HEIGHT;
+    }
+    if(new_y >= GROUND_Y - TOASTER_HEIGHT || hit_row >= 0 ||
+       check_ground_support(game, x, new_y, TOASTER_WIDTH, TOASTER_HEIGHT)) {
+        new_y = MIN(new_y, GROUND_Y - TOASTER_HEIGHT);
+        entities->vy[entity] = 0;
+        entities->flags[entity] |= ENTITY_ON_GROUND;
+    } else {
+        entities->flags[entity] &= ~ENTITY_ON_GROUND;
+    }
+    entities->y[entity] = new_y;
+    
+    // Shoot a crumb towards Panis
+    if(entities->timer[entity] > 0) {
+        entities->timer[entity]--;
+    } else if(x - game->world_x < TOASTER_RANGE && game->world_x - x < TOASTER_RANGE) {
+        int direction = (game->world_x < x) ? -1 : 1;
+        int crumb_x = x + (direction > 0 ? TOASTER_WIDTH : -CRUMB_SIZE);
+        spawn_entity(
+            game,
+            EntityCrumb,
+            crumb_x,
+            new_y + TOASTER_HEIGHT / 2,
+            direction * CRUMB_SPEED,
+            entities->home[entity]);
+        entities->timer[entity] = TOASTER_RELOAD_STEPS;
+    }
+}
+
+// Fly straight, vanish at blocks and the end of the loaded range
+static void update_crumb(Game* game, uint8_t entity) {
+    Entities* entities = &game->entities;
+    int new_x = entities->x[entity] + entities->vx[entity];
+    int first_x, end_x;
+    get_entity_range(game, &first_x, &end_x);
+    if(new_x < first_x || new_x > end_x - CRUMB_SIZE ||
+       check_block_collision(game, new_x, entities->y[entity], CRUMB_SIZE, CRUMB_SIZE)) {
+        despawn_entity(game, entity);
+    } else {
+        move_entity(entities, entity, new_x);
+    }
+}
+
+// Handle Panis touching an entity: jumping on a toaster defeats it, running
+// into one or getting hit by a crumb bumps Panis up
+static void hit_entity(Game* game, uint8_t entity) {
+    Entities* entities = &game->entities;
+    int home = entities->home[entity];
+    bool stomped = entities->type[entity] == EntityToaster && game->y_velocity > 0 &&
+                   game->y_pos + CHAR_HEIGHT <= entities->y[entity] + STOMP_DEPTH;
+    if(stomped) {
+        game->chunk_defeated[home] |= 1 << entities->spawn[entity];
+        game->score += STOMP_SCORE;
+        game->y_velocity = TO_FIXED(SMALL_JUMP_VELOCITY);
+        game->on_ground = false;
+        despawn_entity(game, entity);
+    } else {
+        if(entities->type[entity] == EntityCrumb) {
+            despawn_entity(game, entity);
+        }
+        if(game->on_ground) {
+            game->y_velocity = TO_FIXED(SMALL_JUMP_VELOCITY) / 2;
+            game->on_ground = false;
+        }
+        game->events |= GameEventBump;
+    }
+    game->events |= GameEventChanged;
+}
+
+void game_update_entities(Game* game) {
+    Entities* entities = &game->entities;
+    if(entities->count == 0) {
+        return;
+    }
+    
+    // Update the entities active before this step, crumbs shot now start
+    // moving with the next one. The pool is walked by slot, not by bucket.
+    uint32_t active = 0;
+    for(int entity = 0; entity < MAX_ENTITIES; entity++) {
+        if(entities->flags[entity] & ENTITY_ACTIVE) {
+            active |= 1UL << entity;
+        }
+    }
+    for(int entity = 0; active != 0; entity++, active >>= 1) {
+        if(!(active & 1)) {
+            continue;
+        }
+        if(entities->type[entity] == EntityToaster) {
+            update_toaster(game, entity);
+        } else {
+            update_crumb(game, entity);
+        }
+    }
+    
+    // Redraw when an entity can be on screen
+    int first_col = pixel_to_cell(game->camera_x) - 1;
+    int last_col = pixel_to_cell(game->camera_x + SCREEN_WIDTH - 1);
+    for(int col = first_col; col <= last_col; col++) {
+        if(entities->bucket[column_bucket(col)] != ENTITY_NONE) {
+            game->events |= GameEventChanged;
+            break;
+        }
+    }
+    
+    // Only the buckets around Panis can hold entities touching him
+    uint8_t hits[MAX_ENTITIES];
+    int num_hits = 0;
+    int panis_col = pixel_to_cell(game->world_x);
+    for(int col = panis_col - 1; col <= panis_col + 1; col++) {
+        for(uint8_t entity = entities->bucket[column_bucket(col)]; entity != ENTITY_NONE;
+            entity = entities->next[entity]) {
+            int type = entities->type[entity];
+            if(boxes_overlap(
+                   game->world_x,
+                   game->y_pos,
+                   CHAR_WIDTH,
+                   CHAR_HEIGHT,
+                   entities->x[entity],
+                   entities->y[entity],
+                   entity_width[type],
+                   entity_height[type])) {
+                hits[num_hits++] = entity;
+            }
+        }
+    }
+    for(int i = 0; i < num_hits; i++) {
+        hit_entity(game, hits[i]);
+    }
+}
+
+void game_for_each_entity(
+    const Game* game,
+    int first_col,
+    int last_col,
+    void (*visit)(void* context, const Entities* entities, uint8_t entity),
+    void* context) {
+    // Entities are bucketed by their left edge and at most one cell wide, so
+    // the column left of the range can hold entities reaching into it
+    const Entities* entities = &game->entities;
+    first_col--;
+    if(last_col - first_col >= ENTITY_BUCKETS) {
+        last_col = first_col + ENTITY_BUCKETS - 1;
+    }
+    for(int col = first_col; col <= last_col; col++) {
+        for(uint8_t entity = entities->bucket[column_bucket(col)]; entity != ENTITY_NONE;
+            entity = entities->next[entity]) {
+            visit(context, entities, entity);
+        }
+    }
+}
+
+bool game_is_idle(const Game* game) {
+    // Every active entity moves each step, also out of view
+    return game->on_ground && game->y_velocity == 0 && game->entities.count == 0;
+}
+
+int game_prefetch_index(const Game* game) {
+    int index = game->facing_right ? game->first_chunk + RING_CHUNKS : game->first_chunk - 1;
+    if(index < 0 || index >= game->level_chunks || game->spare == NULL ||
+       game->spare->index == index) {
+        return -1;
+    }
+    return index;
+}
+
+// Get and clear the events of the last updates
+uint32_t game_take_events(Game* game) {
+    uint32_t events = game->events;
+    game->events = 0;
+    return events;
+}
+
+// Hand the journal over and start an empty one
+void game_take_changes(Game* game, CellJournal* journal) {
+    *journal = game->journal;
+    game->journal.count = 0;
+    game->journal.rescan = false;
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Platform independent game core: level, movement, physics and collection.
+// It has no Flipper dependencies; bread.c feeds it input and time, draws its
+// state and turns its events into sound and vibration.
+
+// View size, the camera never shows more than this
+#define SCREEN_WIDTH 128
+#define SCREEN_HEIGHT 64
+
+// Timing: speeds and accelerations are tuned per game step, the physics
+// integrates them over GAME_SUBSTEPS updates per step
+#define GAME_STEP_MS 100  // Duration of a game step
+#define GAME_SUBSTEPS 4   // Physics updates per game step
+
+// Fixed point positions and velocities, FIXED_SHIFT fraction bits (Q8.8)
+#define FIXED_SHIFT 8
+#define FIXED_ONE (1 << FIXED_SHIFT)
+#define TO_FIXED(pixels) ((pixels) * FIXED_ONE)
+#define FIXED_TO_PIXEL(value) ((value) >> FIXED_SHIFT)  // Rounds down, also when negative
+
+// PANIS configuration
+#define MOVEMENT_SPEED 4  // Pixels per game step
+#define GROUND_Y 59  // Y position of the ground line
+
+// Jump physics, in pixels per game step
+#define GRAVITY 2
+#define SMALL_JUMP_VELOCITY -10
+#define BIG_JUMP_VELOCITY -20
+#define MAX_FALL_SPEED 10
+#define MAX_JUMP_HEIGHT 60  // Maximum pixels above ground
+#define JUMP_HEIGHT_THRESHOLD 25  // Height to distinguish small/big jump
+#define DOUBLE_CLICK_MS 900  // Time window for double-click (milliseconds)
+
+// Map tile configuration
+#define TILE_WIDTH 128
+#define TILE_HEIGHT 60
+
+// Character dimensions
+#define CHAR_WIDTH 10
+#define CHAR_HEIGHT 10
+
+// Scrolling thresholds
+#define START_SCROLL_X (SCREEN_WIDTH / 2)  // Start scrolling at 1/2 screen (64px)
+#define CHAR_START_X (SCREEN_WIDTH / 4)    // Character starts at 1/4 screen (32px)
+
+// Grid configuration
+#define CELL_SIZE 10
+#define GRID_ROWS 6
+#define CELL_EMPTY 0
+#define CELL_BLOCK 1
+#define CELL_PILL 2
+#define CELL_DIAMOND 3
+#define CELL_DIAMOND_FILLED 4
+#define CELL_CLOUD 5
+#define CELL_TYPES 6  // Number of cell types, a stored cell above is invalid
+#define CELL_JOURNAL_SIZE 16  // Cell changes kept until game_take_changes
+
+// When touching a cell collects it
+typedef enum {
+    CellTouchNone,    // Never
+    CellTouchAlways,  // Whenever Panis overlaps it
+    CellTouchInAir,   // Only while jumping or falling through it
+} CellTouch;
+
+// Counter a cell type adds to: chunk content when loaded, progress when collected
+typedef enum {
+    CellCounterNone,
+    CellCounterPill,     // Chunk pills; collecting decrements pill_count
+    CellCounterDiamond,  // Chunk diamonds; collecting increments filled_diamonds
+} CellCounter;
+
+// What a cell type does, game_cell_behavior is indexed by the cell type.
+// Collision, collection and counting read it instead of testing cell types.
+typedef struct {
+    bool solid;         // Blocks Panis and the entities
+    uint8_t touch;      // CellTouch
+    uint8_t collected;  // Cell type it turns into when collected
+    uint8_t score;      // Points for collecting it
+    uint8_t counter;    // CellCounter
+    uint8_t event;      // GameEvent bits raised when collected
+} CellBehavior;
+
+extern const CellBehavior game_cell_behavior[CELL_TYPES];
+
+// World configuration: the level is split into chunks of grid columns, only
+// the chunks around the camera are kept in memory
+#define CHUNK_COLS 8  // Grid columns per chunk (one byte per row in the block masks)
+#define CHUNK_WIDTH (CHUNK_COLS * CELL_SIZE)
+#define RING_CHUNKS 4  // Chunks in memory: one behind the camera, up to three on screen
+#define LEVEL_CHUNKS 16  // Length of generated levels in chunks
+#define MAX_LEVEL_CHUNKS 64  // Longest level that can be loaded
+#define GAME_GENERATOR_ID 1  // GameLevel.id of generated levels, bump when the generator changes
+#define MIN_LEVEL_CHUNKS ((SCREEN_WIDTH + CHUNK_WIDTH - 1) / CHUNK_WIDTH)  // At least a screen
+#define MAX_MAP_WIDTH (MAX_LEVEL_CHUNKS * CHUNK_WIDTH)
+#define MAX_LEVEL_TILES ((MAX_MAP_WIDTH + TILE_WIDTH - 1) / TILE_WIDTH)
+
+// Entities: enemies and projectiles
+#define MAX_ENTITIES 32  // Fixed pool, uint8_t indices
+#define MAX_CHUNK_TOASTERS 8  // Toasters spawned per chunk at most, one defeated bit each
+#define ENTITY_NONE 0xFF  // End of an entity list
+#define ENTITY_BUCKETS (RING_CHUNKS * CHUNK_COLS)  // One per loaded grid column
+#define ENTITY_ACTIVE (1 << 0)   // Flag: pool slot in use
+#define ENTITY_ON_GROUND (1 << 1)  // Flag: standing on the ground or a block
+typedef enum {
+    EntityToaster,  // Walks along the ground, shoots crumbs at Panis
+    EntityCrumb,    // Flies straight until it hits something
+} EntityType;
+
+// Entity pool, stored as one array per field. Active entities are linked
+// into the bucket of the grid column their left edge is in, free slots into
+// the free list, both through `next`.
+typedef struct {
+    int16_t x[MAX_ENTITIES];  // World position of the top left corner
+    int16_t y[MAX_ENTITIES];
+    int8_t vx[MAX_ENTITIES];  // Pixels per game step
+    int8_t vy[MAX_ENTITIES];
+    uint8_t type[MAX_ENTITIES];  // EntityType
+    uint8_t flags[MAX_ENTITIES];  // ENTITY_* flags
+    uint8_t timer[MAX_ENTITIES];  // Steps until the next shot (toasters)
+    uint8_t home[MAX_ENTITIES];   // Chunk the entity was spawned in
+    uint8_t spawn[MAX_ENTITIES];  // Number of the toaster among those of its chunk
+    uint8_t next[MAX_ENTITIES];   // Next entity in the same bucket or free list
+    uint8_t bucket[ENTITY_BUCKETS];  // First entity per column `col % ENTITY_BUCKETS`
+    uint8_t free;                 // First free slot
+    uint8_t count;                // Active entities
+} Entities;
+
+// Things that happened during an update, collected until game_take_events
+typedef enum {
+    GameEventChanged = (1 << 0),  // Something on screen changed
+    GameEventPill = (1 << 1),     // Pill collected
+    GameEventDiamond = (1 << 2),  // Diamond activated
+    GameEventBump = (1 << 3),     // Bumped into a block or the level boundary
+} GameEvent;
+
+typedef enum {
+    GameDirectionLeft,
+    GameDirectionRight,
+} GameDirection;
+
+// A cell that changed, in level grid coordinates
+typedef struct {
+    uint16_t col;
+    uint8_t row;
+    uint8_t cell;  // New cell type, as game_get_cell returns it
+} CellChange;
+
+// Cells changed since the last game_take_changes. When more changed than
+// fit, or chunks were loaded, `rescan` is set and the cells must be read
+// again with game_get_cell.
+typedef struct {
+    CellChange changes[CELL_JOURNAL_SIZE];
+    uint8_t count;
+    bool rescan;
+} CellJournal;
+
+// Source of a stored level. Chunks are read on demand, a chunk is
+// GRID_ROWS * CHUNK_COLS cells, row by row. A chunk read_chunk returns false
+// for is left empty.
+typedef struct {
+    uint16_t num_chunks;
+    uint8_t num_tiles;
+    const uint8_t* tiles;  // Background image of each tile, repeated along the level
+    bool (*read_chunk)(void* context, uint16_t index, uint8_t* cells);
+    void* context;
+    uint32_t id;  // Checksum of the level data, tells saved progress which level it is for
+    uint8_t toasters_per_chunk;  // 0 for the usual chance of one, at most MAX_CHUNK_TOASTERS
+} GameLevel;
+
+// Grid cells of one chunk of the level
+typedef struct {
+    int index;             // Chunk number in the level, -1 if the slot is empty
+    uint8_t cells[GRID_ROWS][CHUNK_COLS];
+    uint8_t solid[GRID_ROWS];  // Per row: bit `c` set if cells[row][c] is solid
+    uint8_t blocks;        // Counters of the content, kept by chunk_set_cell
+    uint8_t ground_blocks;
+    uint8_t pills;
+    uint8_t diamonds;
+} Chunk;
+
+typedef struct {
+    int world_x;           // Character's X position in the world (0 to map_width)
+    int x_fraction;        // Sub-pixel part of the X position walked, fixed point
+    int screen_x;          // Character's X position on screen
+    int camera_x;          // Camera offset (how much the world is scrolled)
+    bool facing_right;     // True if facing right, false if facing left
+    int32_t y_fixed;       // Character Y position (0 = top), fixed point
+    int y_pos;             // Character Y position in whole pixels, FIXED_TO_PIXEL(y_fixed)
+    int32_t y_velocity;    // Vertical velocity, fixed point pixels per game step
+    bool on_ground;        // True if character is on ground
+    uint32_t last_jump_time;  // Time of last jump press
+    bool has_jumped;       // False until the first jump press after a (re)start or resume
+    uint32_t level_seed;   // Seed of the generated level
+    GameLevel level;       // Stored level, num_chunks 0 for generated levels
+    int level_chunks;      // Level length in chunks
+    int level_cols;        // Level length in grid columns
+    int map_width;         // Level length in pixels
+    uint8_t tiles[MAX_LEVEL_TILES];  // Background image of each tile
+    Chunk chunk_store[RING_CHUNKS + 1];  // Memory of the ring and the spare
+    Chunk* chunks[RING_CHUNKS];  // Loaded chunks (immutable), chunk `n` lives in slot `n % RING_CHUNKS`
+    Chunk* spare;          // Prefetched chunk swapped in when it is loaded, NULL while lent out
+    int first_chunk;       // First chunk of the loaded range
+    uint64_t collected[MAX_LEVEL_CHUNKS];  // Overlay per chunk: pills collected and diamonds activated, bit row * CHUNK_COLS + c
+    uint8_t chunk_counted[(MAX_LEVEL_CHUNKS + 7) / 8];  // Chunks already included in the counters
+    uint16_t chunk_version[MAX_LEVEL_CHUNKS];  // Bumped whenever blocks or clouds of a chunk change
+    uint8_t chunk_defeated[MAX_LEVEL_CHUNKS];  // Per chunk: bit `i` set if its toaster `i` was defeated
+    Entities entities;     // Enemies and projectiles in the loaded chunks
+    int score;             // Collected pills score
+    int block_count;       // Number of blocks in grid
+    int pill_count;        // Number of pills remaining
+    int overall_pills;     // Total pills placed
+    int overall_diamonds;  // Total diamonds placed
+    int filled_diamonds;   // Number of filled diamonds
+    int ground_blocks;     // Number of blocks on/near ground
+    uint32_t events;       // GameEvent bits since the last game_take_events
+    CellJournal journal;   // Cells changed since the last game_take_changes
+} Game;
+
+// Progress in a level, everything needed to continue it later on the same
+// level and seed. Chunks are not included, they are rebuilt from the level.
+typedef struct {
+    uint16_t level_chunks;  // Level length, to detect a changed level
+    uint8_t facing_right;
+    uint8_t on_ground;
+    uint32_t level_id;  // GameLevel.id, GAME_GENERATOR_ID for generated levels
+    int32_t world_x;
+    int32_t x_fraction;
+    int32_t screen_x;
+    int32_t camera_x;
+    int32_t y_fixed;
+    int32_t y_velocity;
+    int32_t score;
+    int32_t block_count;
+    int32_t pill_count;
+    int32_t overall_pills;
+    int32_t overall_diamonds;
+    int32_t filled_diamonds;
+    int32_t ground_blocks;
+    uint8_t chunk_counted[(MAX_LEVEL_CHUNKS + 7) / 8];
+    uint8_t chunk_defeated[MAX_LEVEL_CHUNKS];
+    uint64_t collected[MAX_LEVEL_CHUNKS];
+} GameProgress;
+
+// Start a new level: the stored level if given, else generated from the seed.
+// The spare chunk must not be lent out to a prefetch (also for game_resume).
+void game_init(Game* game, const GameLevel* level, uint32_t seed);
+
+// Continue a level from saved progress, only the chunks around the saved
+// camera are loaded. Returns false if the progress doesn't fit the level,
+// the game must be started with game_init then.
+bool game_resume(Game* game, const GameLevel* level, uint32_t seed, const GameProgress* progress);
+
+// Save the progress in the current level
+void game_save_progress(const Game* game, GameProgress* progress);
+
+// Restart the current level
+void game_restart(Game* game);
+
+// Move the character for one physics update and scroll the camera
+void game_move(Game* game, GameDirection direction);
+
+// Start a jump, `now` in milliseconds. Two jumps in quick succession jump higher.
+void game_jump(Game* game, uint32_t now);
+
+// Apply gravity and vertical collisions for one physics update
+void game_update_physics(Game* game);
+
+// Collect pills and activate diamonds the character touches
+void game_collect_pills(Game* game);
+
+// Move the entities one game step (every GAME_SUBSTEPS physics updates) and
+// let them interact with Panis
+void game_update_entities(Game* game);
+
+// Call `visit` for every entity overlapping the grid columns first..last
+// (inclusive), at most once each
+void game_for_each_entity(
+    const Game* game,
+    int first_col,
+    int last_col,
+    void (*visit)(void* context, const Entities* entities, uint8_t entity),
+    void* context);
+
+// True when nothing in the level moves without input: Panis stands on the
+// ground and no entity is active, in view or not.
+bool game_is_idle(const Game* game);
+
+// Get a grid cell of the level with what was collected applied. Cells
+// outside loaded chunks are empty.
+uint8_t game_get_cell(const Game* game, int row, int col);
+
+// Get and clear the GameEvent bits
+uint32_t game_take_events(Game* game);
+
+// Get and clear the journal of changed cells
+void game_take_changes(Game* game, CellJournal* journal);
+
+// Chunk the spare should be filled with: the next one ahead in the direction
+// Panis faces. -1 if there is none, the spare already holds it or is lent out.
+int game_prefetch_index(const Game* game);
+
+// Fill a chunk with chunk `index` of the level, generated from the seed if
+// the level has no chunks. Reads nothing but its arguments, so it can fill a
+// lent out spare on another thread if level->read_chunk can run there.
+void game_build_chunk(const GameLevel* level, uint32_t seed, int index, Chunk* chunk);
+
+// Read a chunk of a BuiltinLevel (the context), for GameLevel.read_chunk
+bool game_read_builtin_chunk(void* context, uint16_t index, uint8_t* cells);
@@ -0,0 +1,108 @@
+// Micro-benchmarks of the game core on the PC: physics updates, vertical
+// collision sweeps and chunk generation, in nanoseconds per call.
+// Usage: panis_bench [ticks]
+//
+// game.c is included, so its static collision helpers can be timed too.
+#include "../game.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_TICKS 100000
+#define BENCH_SEED 12345
+
+typedef struct {
+    const char* name;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint64_t calls;
+} Timing;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void timing_add(Timing* timing, uint64_t ns) {
+    if(timing->calls == 0 || ns < timing->min) timing->min = ns;
+    if(ns > timing->max) timing->max = ns;
+    timing->total += ns;
+    timing->calls++;
+}
+
+static void timing_print(const Timing* timing) {
+    printf(
+        "%-22s %10llu calls  min %6llu  avg %8.1f  max %8llu ns\n",
+        timing->name,
+        (unsigned long long)timing->calls,
+        (unsigned long long)timing->min,
+        (double)timing->total / (double)timing->calls,
+        (unsigned long long)timing->max);
+}
+
+static Game game;
+static volatile int sink;  // Keeps the timed results alive
+
+int main(int argc, char** argv) {
+    long ticks = (argc > 1) ? atol(argv[1]) : DEFAULT_TICKS;
+    Timing physics = {"game_update_physics", 0, 0, 0, 0};
+    Timing sweep = {"sweep_vertical", 0, 0, 0, 0};
+    Timing generate = {"game_build_chunk gen", 0, 0, 0, 0};
+    Timing builtin = {"game_build_chunk built", 0, 0, 0, 0};
+
+    GameLevel stored = {
+        .num_chunks = builtin_level.num_chunks,
+        .num_tiles = builtin_level.num_tiles,
+        .tiles = builtin_level.tiles,
+        .read_chunk = game_read_builtin_chunk,
+        .context = (void*)&builtin_level,
+    };
+    GameLevel generated = {0};
+    game_init(&game, &stored, BENCH_SEED);
+
+    Chunk chunk;
+    for(long tick = 0; tick < ticks; tick++) {
+        // Walk right through the level jumping all the time, so the physics
+        // keeps sweeping over blocks; start over at the end
+        if(game.world_x >= game.map_width - CHAR_WIDTH) {
+            game_restart(&game);
+        }
+        game_move(&game, GameDirectionRight);
+        if(game.on_ground) {
+            game_jump(&game, tick * 1000);
+        }
+        uint64_t start = now_ns();
+        game_update_physics(&game);
+        timing_add(&physics, now_ns() - start);
+        game_collect_pills(&game);
+
+        // A full height fall and rise at Panis' column
+        start = now_ns();
+        sink = sweep_vertical(&game, game.world_x, CHAR_WIDTH, CHAR_HEIGHT, 0, GROUND_Y - CHAR_HEIGHT);
+        sink = sweep_vertical(&game, game.world_x, CHAR_WIDTH, CHAR_HEIGHT, GROUND_Y - CHAR_HEIGHT, 0);
+        timing_add(&sweep, (now_ns() - start) / 2);
+
+        // One chunk of each kind every 16 ticks, as often as walking would
+        // need them many times over
+        if(tick % 16 == 0) {
+            int index = (tick / 16) % LEVEL_CHUNKS;
+            start = now_ns();
+            game_build_chunk(&generated, BENCH_SEED, index, &chunk);
+            timing_add(&generate, now_ns() - start);
+            sink = chunk.blocks;
+            start = now_ns();
+            game_build_chunk(&stored, BENCH_SEED, index % stored.num_chunks, &chunk);
+            timing_add(&builtin, now_ns() - start);
+            sink = chunk.blocks;
+        }
+    }
+
+    timing_print(&physics);
+    timing_print(&sweep);
+    timing_print(&generate);
+    timing_print(&builtin);
+    return 0;
+}
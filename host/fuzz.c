@@ -0,0 +1,197 @@
+#include "game.h"
+#include "builtin_level.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Drives the game core with random input and checks its invariants after
+// every physics update. Built with -DPANIS_LIBFUZZER the input comes from
+// libFuzzer, else from a seeded random loop: panis_fuzz [runs] [seed].
+//
+// Input layout: 4 bytes level seed, 1 byte level (bit 0: built-in instead
+// of generated, bit 1: with MAX_CHUNK_TOASTERS toasters per chunk), then one
+// byte per physics update:
+//   bit 0  walk right    bit 1  walk left
+//   bit 2  press jump    0xFF   restart the level
+//
+// Restarting must also keep the defeated toasters defeated, and the first jump
+// after starting or restarting is always a small one.
+
+#define STEP_MS (GAME_STEP_MS / GAME_SUBSTEPS)
+#define RUN_STEPS 4000  // Updates per run of the random loop
+#define INPUT_RESTART 0xFF
+
+static Game game;
+
+// Report a broken invariant with the update it happened in
+static void fail(size_t step, const char* what) {
+    fprintf(
+        stderr,
+        "step %zu: %s (world_x %d, y_pos %d, camera_x %d, score %d)\n",
+        step,
+        what,
+        game.world_x,
+        game.y_pos,
+        game.camera_x,
+        game.score);
+    abort();
+}
+
+// Grid cell of a world pixel coordinate, rounding down also above the grid
+static int cell_of(int px) {
+    return (px >= 0) ? px / CELL_SIZE : -((CELL_SIZE - 1 - px) / CELL_SIZE);
+}
+
+// True if Panis overlaps a solid cell
+static bool inside_solid(void) {
+    for(int row = cell_of(game.y_pos); row <= cell_of(game.y_pos + CHAR_HEIGHT - 1); row++) {
+        for(int col = cell_of(game.world_x); col <= cell_of(game.world_x + CHAR_WIDTH - 1); col++) {
+            if(game_cell_behavior[game_get_cell(&game, row, col)].solid) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void check_invariants(size_t step) {
+    if(inside_solid()) {
+        fail(step, "Panis tunneled into a solid cell");
+    }
+    if(game.y_pos != FIXED_TO_PIXEL(game.y_fixed)) {
+        fail(step, "y_pos out of step with y_fixed");
+    }
+    if(game.y_pos > GROUND_Y - CHAR_HEIGHT ||
+       game.y_pos < GROUND_Y - CHAR_HEIGHT - MAX_JUMP_HEIGHT) {
+        fail(step, "y_pos out of bounds");
+    }
+    if(game.world_x < 0 || game.world_x > game.map_width - CHAR_WIDTH) {
+        fail(step, "world_x outside the level");
+    }
+    if(game.camera_x < 0 || game.camera_x > game.map_width - SCREEN_WIDTH ||
+       game.screen_x != game.world_x - game.camera_x) {
+        fail(step, "camera out of step with Panis");
+    }
+    if(game.score < 0 || game.pill_count < 0 || game.block_count < 0 ||
+       game.ground_blocks < 0 || game.filled_diamonds < 0 || game.overall_pills < 0 ||
+       game.overall_diamonds < 0) {
+        fail(step, "negative counter");
+    }
+    for(int entity = 0; entity < MAX_ENTITIES; entity++) {
+        const Entities* entities = &game.entities;
+        if((entities->flags[entity] & ENTITY_ACTIVE) && entities->type[entity] == EntityToaster &&
+           (game.chunk_defeated[entities->home[entity]] & (1 << entities->spawn[entity]))) {
+            fail(step, "defeated toaster is back");
+        }
+    }
+    if(game.pill_count > game.overall_pills || game.filled_diamonds > game.overall_diamonds ||
+       game.ground_blocks > game.block_count) {
+        fail(step, "counters disagree");
+    }
+}
+
+// Play one input sequence
+static void run(const uint8_t* data, size_t size) {
+    if(size < 5) {
+        return;
+    }
+    uint32_t seed = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    GameLevel level = {0};
+    if(data[4] & 1) {
+        level.num_chunks = builtin_level.num_chunks;
+        level.num_tiles = builtin_level.num_tiles;
+        level.tiles = builtin_level.tiles;
+        level.read_chunk = game_read_builtin_chunk;
+        level.context = (void*)&builtin_level;
+        level.id = builtin_level.id;
+        if(data[4] & 2) {
+            level.toasters_per_chunk = MAX_CHUNK_TOASTERS;
+        }
+    }
+    game_init(&game, &level, seed);
+    check_invariants(0);
+
+    bool jump_held = false;
+    bool jumped = false;  // Jumped since the level (re)started
+    for(size_t step = 1; step + 4 < size; step++) {
+        uint8_t input = data[step + 4];
+        if(input == INPUT_RESTART) {
+            uint8_t defeated[sizeof(game.chunk_defeated)];
+            memcpy(defeated, game.chunk_defeated, sizeof(defeated));
+            game_restart(&game);
+            jumped = false;
+            if(memcmp(defeated, game.chunk_defeated, sizeof(defeated)) != 0) {
+                fail(step, "defeated toasters came back on restart");
+            }
+            check_invariants(step);
+            continue;
+        }
+        // Same order as the game loop: movement, physics, collecting,
+        // entities every game step
+        bool jump = input & (1 << 2);
+        if(jump && !jump_held) {
+            bool first = !jumped && game.on_ground;
+            jumped = jumped || game.on_ground;
+            game_jump(&game, step * STEP_MS);
+            if(first && game.y_velocity != TO_FIXED(SMALL_JUMP_VELOCITY)) {
+                fail(step, "first jump was a double click");
+            }
+        }
+        jump_held = jump;
+        if(input & (1 << 0)) {
+            game_move(&game, GameDirectionRight);
+        } else if(input & (1 << 1)) {
+            game_move(&game, GameDirectionLeft);
+        }
+        game_update_physics(&game);
+        game_collect_pills(&game);
+        if(step % GAME_SUBSTEPS == 0) {
+            game_update_entities(&game);
+        }
+        game_take_events(&game);
+        CellJournal journal;
+        game_take_changes(&game, &journal);
+        check_invariants(step);
+    }
+}
+
+#ifdef PANIS_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    run(data, size);
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    int runs = (argc > 1) ? atoi(argv[1]) : 100;
+    unsigned seed = (argc > 2) ? (unsigned)strtoul(argv[2], NULL, 0) : 1;
+    srand(seed);
+
+    static uint8_t data[5 + RUN_STEPS];
+    for(int i = 0; i < runs; i++) {
+        // Walk in long stretches with some jumping, like a player would,
+        // and restart now and then
+        int direction = 0;
+        for(size_t j = 0; j < sizeof(data); j++) {
+            if(j < 5) {
+                data[j] = rand();
+                continue;
+            }
+            if(rand() % 64 == 0) {
+                direction = rand() % 4;
+            }
+            data[j] = (uint8_t)(direction | ((rand() % 8 == 0) ? 1 << 2 : 0));
+            if(rand() % 2000 == 0) {
+                data[j] = INPUT_RESTART;
+            }
+        }
+        run(data, sizeof(data));
+    }
+    printf("%d runs of %d updates passed (seed %u)\n", runs, RUN_STEPS, seed);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "input_log.h"
+#include "arena.h"
+
+#define TAG "PanisInput"
+
+#define INPUT_LOG_HEADER_SIZE 12
+#define INPUT_LOG_RECORD_SIZE 6
+#define INPUT_LOG_BUFFER_RECORDS 64  // Records written or read at once
+
+struct InputLog {
+    File* file;            // NULL for a script
+    const InputRecord* script;  // Records replayed from memory
+    size_t script_size;
+    bool recording;
+    uint8_t buffer[INPUT_LOG_BUFFER_RECORDS * INPUT_LOG_RECORD_SIZE];
+    size_t size;     // Bytes in the buffer
+    size_t pos;      // Read position in the buffer, record index for a script (replay)
+};
+
+_Static_assert(sizeof(InputLog) <= ARENA_BUDGET_INPUT_LOG, "InputLog exceeds its arena budget");
+
+static void write_le32(uint8_t* data, uint32_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static uint32_t read_le32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static InputLog* input_log_alloc(Storage* storage, bool recording) {
+    InputLog* log = arena_alloc(ArenaInputLog, sizeof(InputLog));
+    log->file = (storage != NULL) ? storage_file_alloc(storage) : NULL;
+    log->recording = recording;
+    log->size = 0;
+    log->pos = 0;
+    return log;
+}
+
+static void input_log_free(InputLog* log) {
+    if(log->file != NULL) {
+        storage_file_close(log->file);
+        storage_file_free(log->file);
+    }
+    arena_reset(ArenaInputLog);
+}
+
+InputLog* input_log_record(Storage* storage, const char* path, InputLogLevel level, uint32_t seed) {
+    InputLog* log = input_log_alloc(storage, true);
+    if(!storage_file_open(log->file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        FURI_LOG_W(TAG, "Can't create %s", path);
+        input_log_free(log);
+        return NULL;
+    }
+    
+    uint8_t header[INPUT_LOG_HEADER_SIZE] = {'P', 'N', 'I', 'R', INPUT_LOG_VERSION, level};
+    write_le32(&header[8], seed);
+    storage_file_write(log->file, header, sizeof(header));
+    FURI_LOG_I(TAG, "Recording to %s", path);
+    return log;
+}
+
+InputLog* input_log_replay(Storage* storage, const char* path, InputLogLevel* level, uint32_t* seed) {
+    InputLog* log = input_log_alloc(storage, false);
+    uint8_t header[INPUT_LOG_HEADER_SIZE];
+    if(!storage_file_open(log->file, path, FSAM_READ, FSOM_OPEN_EXISTING) ||
+       storage_file_read(log->file, header, sizeof(header)) != sizeof(header) ||
+       memcmp(header, "PNIR", 4) != 0 || header[4] != INPUT_LOG_VERSION) {
+        FURI_LOG_W(TAG, "No valid recording in %s", path);
+        input_log_free(log);
+        return NULL;
+    }
+    
+    *level = header[5];
+    *seed = read_le32(&header[8]);
+    FURI_LOG_I(TAG, "Replaying %s", path);
+    return log;
+}
+
+InputLog* input_log_script(const InputRecord* records, size_t count) {
+    InputLog* log = input_log_alloc(NULL, false);
+    log->script = records;
+    log->script_size = count;
+    return log;
+}
+
+// Write the buffered records to the file
+static void input_log_flush(InputLog* log) {
+    if(log->size > 0 && storage_file_write(log->file, log->buffer, log->size) != log->size) {
+        FURI_LOG_W(TAG, "Recording incomplete");
+    }
+    log->size = 0;
+}
+
+void input_log_write(InputLog* log, const InputRecord* record) {
+    furi_assert(log->recording);
+    uint8_t* data = &log->buffer[log->size];
+    write_le32(data, record->step);
+    data[4] = record->key;
+    data[5] = record->type;
+    log->size += INPUT_LOG_RECORD_SIZE;
+    if(log->size == sizeof(log->buffer)) {
+        input_log_flush(log);
+    }
+}
+
+bool input_log_peek(InputLog* log, InputRecord* record) {
+    furi_assert(!log->recording);
+    if(log->script != NULL) {
+        if(log->pos >= log->script_size) {
+            return false;
+        }
+        *record = log->script[log->pos];
+        return true;
+    }
+    if(log->pos + INPUT_LOG_RECORD_SIZE > log->size) {
+        // Refill the buffer, a torn record at the end of the file is dropped
+        size_t left = log->size - log->pos;
+        memmove(log->buffer, &log->buffer[log->pos], left);
+        log->size = left + storage_file_read(log->file, &log->buffer[left], sizeof(log->buffer) - left);
+        log->pos = 0;
+        if(log->size < INPUT_LOG_RECORD_SIZE) {
+            return false;
+        }
+    }
+    const uint8_t* data = &log->buffer[log->pos];
+    record->step = read_le32(data);
+    record->key = data[4];
+    record->type = data[5];
+    return true;
+}
+
+void input_log_next(InputLog* log) {
+    log->pos += (log->script != NULL) ? 1 : INPUT_LOG_RECORD_SIZE;
+}
+
+void input_log_close(InputLog* log, uint32_t step) {
+    if(log->recording) {
+        InputRecord end = {.step = step, .key = INPUT_LOG_END, .type = 0};
+        input_log_write(log, &end);
+        input_log_flush(log);
+    }
+    input_log_free(log);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <furi.h>
+#include <storage/storage.h>
+
+// Recorded input sessions on the SD card, for replaying a run exactly.
+// All values are little endian.
+//
+//  Offset     Size       Content
+//  0          4          Magic "PNIR"
+//  4          1          Format version (INPUT_LOG_VERSION)
+//  5          1          Level source (InputLogLevel)
+//  6          2          Reserved, 0
+//  8          4          Level seed
+//  12         6*n        Records: physics step (u32), key, type
+//
+// The last record has the key INPUT_LOG_END and the step the session ended.
+
+#define INPUT_LOG_PATH APP_DATA_PATH("input.pnr")
+#define INPUT_LOG_VERSION 2  // Bumped whenever the physics step duration changes
+#define INPUT_LOG_HELD 0x80  // Flag in InputRecord.type: held key pressed/released, not an event
+#define INPUT_LOG_END 0xFF   // InputRecord.key of the end record
+
+// Level a session was played on
+typedef enum {
+    InputLogLevelGenerated,
+    InputLogLevelBuiltin,
+    InputLogLevelFile,
+} InputLogLevel;
+
+typedef struct {
+    uint32_t step;  // Physics steps done before the input was handled
+    uint8_t key;    // InputKey or INPUT_LOG_END
+    uint8_t type;   // InputType, with INPUT_LOG_HELD for held key changes
+} InputRecord;
+
+typedef struct InputLog InputLog;
+
+// Start recording a session, replaces an older recording.
+// Returns NULL if the file can't be created.
+InputLog* input_log_record(Storage* storage, const char* path, InputLogLevel level, uint32_t seed);
+
+// Open a recording for replay. Returns NULL if it is missing or invalid.
+InputLog* input_log_replay(Storage* storage, const char* path, InputLogLevel* level, uint32_t* seed);
+
+// Replay records from memory instead of a file, e.g. a scripted session.
+// The records must stay valid until the log is closed.
+InputLog* input_log_script(const InputRecord* records, size_t count);
+
+// Add a record. Records are buffered and written in blocks.
+void input_log_write(InputLog* log, const InputRecord* record);
+
+// Get the next record without consuming it. Returns false at the end of
+// the recording.
+bool input_log_peek(InputLog* log, InputRecord* record);
+
+// Consume the record returned by input_log_peek
+void input_log_next(InputLog* log);
+
+// A recording gets its end record at `step` and is flushed, then closed
+void input_log_close(InputLog* log, uint32_t step);
@@ -0,0 +1,186 @@
+#include "level_file.h"
+#include "arena.h"
+
+#define TAG "PanisLevel"
+
+#define LEVEL_FILE_HEADER_SIZE 12
+#define LEVEL_FILE_MAX_CHUNK_CELLS 64
+#define LEVEL_FILE_CRC_READ_SIZE 64  // Bytes read at a time for the checksum
+
+struct LevelFile {
+    File* file;
+    FuriMutex* mutex;  // Serializes chunk reads of the game loop and the prefetcher
+    uint8_t rows;
+    uint8_t cols;
+    uint16_t num_chunks;
+    uint32_t id;             // CRC-32 of the file
+    uint8_t tile_list_size;  // Tiles in the file
+    uint8_t num_tiles;       // Tiles loaded, at most LEVEL_FILE_MAX_TILES
+    uint8_t tiles[LEVEL_FILE_MAX_TILES];
+};
+
+_Static_assert(sizeof(LevelFile) <= ARENA_BUDGET_LEVEL_FILE, "LevelFile exceeds its arena budget");
+
+static uint16_t read_le16(const uint8_t* data) {
+    return data[0] | (data[1] << 8);
+}
+
+static uint32_t read_le32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// CRC-32 (as zlib computes it) of the whole file, read in small pieces
+static bool checksum_file(File* file, uint32_t* crc) {
+    if(!storage_file_seek(file, 0, true)) {
+        return false;
+    }
+    uint8_t data[LEVEL_FILE_CRC_READ_SIZE];
+    uint32_t value = 0xFFFFFFFF;
+    size_t size;
+    do {
+        size = storage_file_read(file, data, sizeof(data));
+        for(size_t i = 0; i < size; i++) {
+            value ^= data[i];
+            for(int bit = 0; bit < 8; bit++) {
+                value = (value >> 1) ^ (0xEDB88320 & -(value & 1));
+            }
+        }
+    } while(size == sizeof(data));
+    *crc = ~value;
+    return storage_file_get_error(file) == FSE_OK;
+}
+
+LevelFile* level_file_open(Storage* storage, const char* path, uint8_t rows, uint8_t cols) {
+    LevelFile* level = arena_alloc(ArenaLevelFile, sizeof(LevelFile));
+    level->file = storage_file_alloc(storage);
+    level->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    
+    uint8_t header[LEVEL_FILE_HEADER_SIZE];
+    bool valid = false;
+    do {
+        if(!storage_file_open(level->file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+            break;
+        }
+        if(storage_file_read(level->file, header, sizeof(header)) != sizeof(header)) {
+            break;
+        }
+        if(memcmp(header, "PNLV", 4) != 0 || header[4] != LEVEL_FILE_VERSION) {
+            FURI_LOG_W(TAG, "Unknown level format");
+            break;
+        }
+        if(header[5] != rows || header[6] != cols || rows * cols > LEVEL_FILE_MAX_CHUNK_CELLS) {
+            FURI_LOG_W(TAG, "Chunk size %ux%u not supported", header[5], header[6]);
+            break;
+        }
+        level->rows = rows;
+        level->cols = cols;
+        level->tile_list_size = header[7];
+        level->num_tiles = MIN(header[7], LEVEL_FILE_MAX_TILES);
+        level->num_chunks = read_le16(&header[8]);
+        if(level->num_chunks == 0 || level->num_tiles == 0) {
+            break;
+        }
+        if(storage_file_read(level->file, level->tiles, level->num_tiles) != level->num_tiles) {
+            break;
+        }
+        if(!checksum_file(level->file, &level->id)) {
+            break;
+        }
+        valid = true;
+    } while(false);
+    
+    if(!valid) {
+        level_file_close(level);
+        return NULL;
+    }
+    FURI_LOG_I(TAG, "Loaded %s: %u chunks", path, level->num_chunks);
+    return level;
+}
+
+void level_file_close(LevelFile* level) {
+    storage_file_close(level->file);
+    storage_file_free(level->file);
+    furi_mutex_free(level->mutex);
+    arena_reset(ArenaLevelFile);
+}
+
+uint16_t level_file_get_num_chunks(LevelFile* level) {
+    return level->num_chunks;
+}
+
+uint32_t level_file_get_id(LevelFile* level) {
+    return level->id;
+}
+
+uint8_t level_file_get_num_tiles(LevelFile* level) {
+    return level->num_tiles;
+}
+
+const uint8_t* level_file_get_tiles(LevelFile* level) {
+    return level->tiles;
+}
+
+// Decode the run-length coded rows of a chunk
+static bool decode_chunk(const uint8_t* data, size_t size, uint8_t* cells, uint8_t rows, uint8_t cols) {
+    size_t pos = 0;
+    for(uint8_t row = 0; row < rows; row++) {
+        uint8_t col = 0;
+        while(col < cols) {
+            if(pos >= size) {
+                return false;
+            }
+            uint8_t run = (data[pos] >> 4) + 1;
+            uint8_t cell = data[pos] & 0x0F;
+            pos++;
+            if(col + run > cols) {
+                return false;  // Runs never cross rows
+            }
+            memset(&cells[row * cols + col], cell, run);
+            col += run;
+        }
+    }
+    return true;
+}
+
+// Read a chunk, the caller holds the mutex
+static bool read_chunk(LevelFile* level, uint16_t index, uint8_t* cells) {
+    size_t num_cells = level->rows * level->cols;
+    memset(cells, 0, num_cells);
+    if(index >= level->num_chunks) {
+        return false;
+    }
+    
+    // Offsets of this and the next chunk
+    uint8_t offsets[8];
+    uint32_t table = LEVEL_FILE_HEADER_SIZE + level->tile_list_size + index * 4;
+    if(!storage_file_seek(level->file, table, true) ||
+       storage_file_read(level->file, offsets, sizeof(offsets)) != sizeof(offsets)) {
+        return false;
+    }
+    uint32_t start = read_le32(&offsets[0]);
+    uint32_t end = read_le32(&offsets[4]);
+    
+    // Every run covers at least one cell, so a valid chunk fits this buffer
+    uint8_t data[LEVEL_FILE_MAX_CHUNK_CELLS];
+    size_t size = end - start;
+    if(end < start || size > num_cells) {
+        return false;
+    }
+    if(!storage_file_seek(level->file, start, true) ||
+       storage_file_read(level->file, data, size) != size) {
+        return false;
+    }
+    if(!decode_chunk(data, size, cells, level->rows, level->cols)) {
+        FURI_LOG_W(TAG, "Chunk %u is corrupt", index);
+        memset(cells, 0, num_cells);
+        return false;
+    }
+    return true;
+}
+
+bool level_file_read_chunk(LevelFile* level, uint16_t index, uint8_t* cells) {
+    furi_mutex_acquire(level->mutex, FuriWaitForever);
+    bool read = read_chunk(level, index, cells);
+    furi_mutex_release(level->mutex);
+    return read;
+}
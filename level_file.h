@@ -0,0 +1,50 @@
+#pragma once
+
+#include <furi.h>
+#include <storage/storage.h>
+
+// Handcrafted levels stored on the SD card. All values are little endian.
+//
+//  Offset     Size       Content
+//  0          4          Magic "PNLV"
+//  4          1          Format version (LEVEL_FILE_VERSION)
+//  5          1          Grid rows per chunk
+//  6          1          Grid columns per chunk
+//  7          1          Number of background tiles T
+//  8          2          Number of chunks N
+//  10         2          Reserved, 0
+//  12         T          Background tile list, one image index per 128 px tile
+//  12+T       4*(N+1)    Chunk offsets from the start of the file, chunk i
+//                        spans offsets[i]..offsets[i+1]
+//  ...                   Chunk data: the rows of each chunk top to bottom, every
+//                        row run-length coded as bytes (run length - 1) << 4 | cell
+//
+// Chunks are read one at a time when they scroll into range, the file is never
+// loaded as a whole.
+
+#define LEVEL_FILE_PATH APP_DATA_PATH("level.pnl")
+#define LEVEL_FILE_VERSION 1
+#define LEVEL_FILE_MAX_TILES 64
+
+typedef struct LevelFile LevelFile;
+
+// Open a level file and check it describes chunks of rows x cols cells.
+// Returns NULL if the file is missing or invalid.
+LevelFile* level_file_open(Storage* storage, const char* path, uint8_t rows, uint8_t cols);
+
+void level_file_close(LevelFile* level);
+
+// Number of chunks in the level
+uint16_t level_file_get_num_chunks(LevelFile* level);
+
+// CRC-32 of the whole file, tells saved progress which level it is for
+uint32_t level_file_get_id(LevelFile* level);
+
+// Background tile list
+uint8_t level_file_get_num_tiles(LevelFile* level);
+const uint8_t* level_file_get_tiles(LevelFile* level);
+
+// Read and decode the rows x cols cells of a chunk (row major) into `cells`.
+// Returns false if the chunk can't be read, `cells` is cleared then. Can be
+// called from several threads, reads are done one at a time.
+bool level_file_read_chunk(LevelFile* level, uint16_t index, uint8_t* cells);
@@ -0,0 +1,89 @@
+#include "prefetch.h"
+#include "arena.h"
+
+#define PREFETCH_STACK_SIZE 1024
+#define PREFETCH_FLAG_WORK (1 << 0)  // A request is waiting
+#define PREFETCH_FLAG_EXIT (1 << 1)
+
+struct ChunkPrefetcher {
+    FuriThread* thread;
+    FuriSemaphore* idle;  // Held by the worker while it fills the chunk
+    
+    // Request, written by the game loop only while it holds `idle`
+    GameLevel level;
+    uint32_t seed;
+    int index;
+    Chunk* chunk;  // Spare chunk lent out by the game, NULL if the game has it
+};
+
+_Static_assert(
+    sizeof(ChunkPrefetcher) <= ARENA_BUDGET_PREFETCH, "ChunkPrefetcher exceeds its arena budget");
+
+// Worker thread: fills the lent out chunk whenever a request comes in
+static int32_t prefetch_worker(void* context) {
+    ChunkPrefetcher* prefetcher = context;
+    
+    while(true) {
+        uint32_t flags = furi_thread_flags_wait(
+            PREFETCH_FLAG_WORK | PREFETCH_FLAG_EXIT, FuriFlagWaitAny, FuriWaitForever);
+        if(flags & FuriFlagError) {
+            continue;
+        }
+        if(flags & PREFETCH_FLAG_EXIT) {
+            break;
+        }
+        game_build_chunk(&prefetcher->level, prefetcher->seed, prefetcher->index, prefetcher->chunk);
+        furi_semaphore_release(prefetcher->idle);
+    }
+    return 0;
+}
+
+ChunkPrefetcher* chunk_prefetcher_alloc(void) {
+    ChunkPrefetcher* prefetcher = arena_alloc(ArenaPrefetch, sizeof(ChunkPrefetcher));
+    prefetcher->idle = furi_semaphore_alloc(1, 1);
+    prefetcher->chunk = NULL;
+    
+    // Below the game loop, it only uses the time the frames leave over
+    prefetcher->thread = furi_thread_alloc();
+    furi_thread_set_name(prefetcher->thread, "PanisPrefetch");
+    furi_thread_set_stack_size(prefetcher->thread, PREFETCH_STACK_SIZE);
+    furi_thread_set_priority(prefetcher->thread, FuriThreadPriorityLow);
+    furi_thread_set_context(prefetcher->thread, prefetcher);
+    furi_thread_set_callback(prefetcher->thread, prefetch_worker);
+    furi_thread_start(prefetcher->thread);
+    return prefetcher;
+}
+
+void chunk_prefetcher_free(ChunkPrefetcher* prefetcher, Game* game) {
+    furi_semaphore_acquire(prefetcher->idle, FuriWaitForever);
+    if(prefetcher->chunk != NULL) {
+        game->spare = prefetcher->chunk;
+    }
+    furi_thread_flags_set(furi_thread_get_id(prefetcher->thread), PREFETCH_FLAG_EXIT);
+    furi_thread_join(prefetcher->thread);
+    furi_thread_free(prefetcher->thread);
+    furi_semaphore_free(prefetcher->idle);
+    arena_reset(ArenaPrefetch);
+}
+
+void chunk_prefetcher_update(ChunkPrefetcher* prefetcher, Game* game) {
+    if(furi_semaphore_acquire(prefetcher->idle, 0) != FuriStatusOk) {
+        return;  // Still filling the chunk
+    }
+    if(prefetcher->chunk != NULL) {
+        game->spare = prefetcher->chunk;
+        prefetcher->chunk = NULL;
+    }
+    
+    int index = game_prefetch_index(game);
+    if(index < 0) {
+        furi_semaphore_release(prefetcher->idle);
+        return;
+    }
+    prefetcher->level = game->level;
+    prefetcher->seed = game->level_seed;
+    prefetcher->index = index;
+    prefetcher->chunk = game->spare;
+    game->spare = NULL;
+    furi_thread_flags_set(furi_thread_get_id(prefetcher->thread), PREFETCH_FLAG_WORK);
+}
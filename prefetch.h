@@ -0,0 +1,23 @@
+#pragma once
+
+#include <furi.h>
+
+#include "game.h"
+
+// Fills the spare chunk of the game on a low priority worker thread while
+// Panis walks through the loaded ones, so scrolling into the next chunk
+// swaps in a finished chunk instead of generating or reading it from the SD
+// card in the middle of a frame.
+
+typedef struct ChunkPrefetcher ChunkPrefetcher;
+
+// Start the prefetch worker
+ChunkPrefetcher* chunk_prefetcher_alloc(void);
+
+// Wait for a running prefetch, then stop and free the worker. The spare
+// chunk is back in the game afterwards.
+void chunk_prefetcher_free(ChunkPrefetcher* prefetcher, Game* game);
+
+// Hand a finished spare chunk back to the game and lend it out again for the
+// next chunk ahead. Never blocks, call it on the game loop after the updates.
+void chunk_prefetcher_update(ChunkPrefetcher* prefetcher, Game* game);
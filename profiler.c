@@ -0,0 +1,187 @@
+#include "profiler.h"
+
+#ifdef PANIS_PROFILER
+
+#include <furi_hal.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROFILER_WINDOW_MS 1000
+#define PROFILER_LINE_HEIGHT 7
+#define PROFILER_BUCKETS 64  // Four per octave, up to 131 ms
+
+// Statistics of the window being measured, owned by the recording thread
+typedef struct {
+    uint32_t window;
+    uint32_t count;
+    uint32_t sum;
+    uint32_t min;
+    uint32_t max;
+} StageWindow;
+
+// Results of the last complete window, in microseconds
+typedef struct {
+    volatile uint32_t min;
+    volatile uint32_t avg;
+    volatile uint32_t max;
+} StageResult;
+
+static const char* const stage_names[ProfileStageCount] = {
+    "Input", "Game", "Phys", "Coll", "Ent", "Layer", "Cells", "Grid", "HUD",
+};
+
+// Measurements of a stage by duration, owned by the recording thread
+typedef struct {
+    uint32_t buckets[PROFILER_BUCKETS];
+    uint32_t samples;
+    uint32_t max;  // Microseconds
+} StageHistogram;
+
+static StageWindow windows[ProfileStageCount];
+static StageResult results[ProfileStageCount];
+static volatile uint32_t window;  // Number of the current window
+static uint32_t window_start;     // Tick the current window started
+static uint32_t frames;           // Frames drawn in the current window
+static uint32_t fps;              // Frames per second of the last window
+static StageHistogram histograms[ProfileStageCount];
+static volatile bool histograms_enabled;
+static uint32_t cycles_per_us;
+
+void profiler_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    memset(windows, 0, sizeof(windows));
+    memset(results, 0, sizeof(results));
+    window = 0;
+    window_start = furi_get_tick();
+    frames = 0;
+    fps = 0;
+    histograms_enabled = false;
+    cycles_per_us = furi_hal_cortex_instructions_per_microsecond();
+}
+
+// Histogram bucket of a duration: exact below 4 us, then four buckets per
+// power of two
+static int histogram_bucket(uint32_t us) {
+    if(us < 4) {
+        return us;
+    }
+    int octave = 31 - __builtin_clz(us);
+    int bucket = (octave - 1) * 4 + ((us >> (octave - 2)) & 3);
+    return MIN(bucket, PROFILER_BUCKETS - 1);
+}
+
+// Largest duration in a bucket
+static uint32_t histogram_bucket_max(int bucket) {
+    if(bucket < 4) {
+        return bucket;
+    }
+    int octave = bucket / 4 + 1;
+    return ((uint32_t)(5 + bucket % 4) << (octave - 2)) - 1;
+}
+
+void profiler_histograms_start(void) {
+    histograms_enabled = false;
+    memset(histograms, 0, sizeof(histograms));
+    histograms_enabled = true;
+}
+
+void profiler_histograms_stop(void) {
+    histograms_enabled = false;
+}
+
+void profiler_summarize(ProfileStage stage, ProfileSummary* summary) {
+    const StageHistogram* histogram = &histograms[stage];
+    uint32_t* const percentiles[] = {&summary->p50, &summary->p90, &summary->p99};
+    static const uint8_t percents[] = {50, 90, 99};
+    summary->samples = histogram->samples;
+    summary->max = histogram->max;
+    
+    // Walk the buckets until each percentile's share of the samples is reached
+    uint32_t seen = 0;
+    size_t next = 0;
+    for(int bucket = 0; bucket < PROFILER_BUCKETS && next < COUNT_OF(percents); bucket++) {
+        seen += histogram->buckets[bucket];
+        while(next < COUNT_OF(percents) &&
+              (uint64_t)seen * 100 >= (uint64_t)histogram->samples * percents[next]) {
+            *percentiles[next++] = MIN(histogram_bucket_max(bucket), histogram->max);
+        }
+    }
+    while(next < COUNT_OF(percents)) {
+        *percentiles[next++] = histogram->max;
+    }
+}
+
+const char* profiler_stage_name(ProfileStage stage) {
+    return stage_names[stage];
+}
+
+void profiler_record(ProfileStage stage, uint32_t cycles) {
+    StageWindow* stats = &windows[stage];
+    
+    // Publish the previous window on the first measurement of a new one
+    if(stats->window != window) {
+        if(stats->count > 0) {
+            uint32_t cycles_per_us = furi_hal_cortex_instructions_per_microsecond();
+            results[stage].min = stats->min / cycles_per_us;
+            results[stage].avg = stats->sum / stats->count / cycles_per_us;
+            results[stage].max = stats->max / cycles_per_us;
+        }
+        stats->window = window;
+        stats->count = 0;
+        stats->sum = 0;
+        stats->min = UINT32_MAX;
+        stats->max = 0;
+    }
+    
+    stats->count++;
+    stats->sum += cycles;
+    if(cycles < stats->min) stats->min = cycles;
+    if(cycles > stats->max) stats->max = cycles;
+    
+    if(histograms_enabled) {
+        StageHistogram* histogram = &histograms[stage];
+        uint32_t us = cycles / cycles_per_us;
+        histogram->buckets[histogram_bucket(us)]++;
+        histogram->samples++;
+        if(us > histogram->max) histogram->max = us;
+    }
+}
+
+void profiler_frame(void) {
+    frames++;
+    uint32_t elapsed = furi_get_tick() - window_start;
+    if(elapsed >= furi_ms_to_ticks(PROFILER_WINDOW_MS)) {
+        fps = frames * furi_kernel_get_tick_frequency() / elapsed;
+        frames = 0;
+        window_start += elapsed;
+        window++;
+    }
+}
+
+void profiler_draw(Canvas* canvas) {
+    char line[32];
+    canvas_clear(canvas);
+    canvas_set_color(canvas, ColorBlack);
+    canvas_set_font(canvas, FontSecondary);
+    
+    int y = 0;
+    for(int stage = 0; stage < ProfileStageCount; stage++) {
+        y += PROFILER_LINE_HEIGHT;
+        canvas_draw_str(canvas, 1, y, stage_names[stage]);
+        snprintf(
+            line,
+            sizeof(line),
+            "%lu/%lu/%lu",
+            (unsigned long)results[stage].min,
+            (unsigned long)results[stage].avg,
+            (unsigned long)results[stage].max);
+        canvas_draw_str(canvas, 24, y, line);
+    }
+    
+    // Frame rate in the top right corner, next to the min/avg/max microseconds
+    snprintf(line, sizeof(line), "%lu FPS", (unsigned long)fps);
+    canvas_draw_str_aligned(canvas, 127, 0, AlignRight, AlignTop, line);
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <furi.h>
+#include <gui/gui.h>
+
+// Frame time profiler. Build with the PANIS_PROFILER define to enable it,
+// without it the macros below expand to nothing and no code is compiled in.
+
+// Timed stages of a frame
+typedef enum {
+    ProfileStageInput,    // Input handling
+    ProfileStageGame,     // Horizontal movement and scrolling (game_move)
+    ProfileStagePhysics,  // Gravity and collisions (game_update_physics)
+    ProfileStageCollect,  // Pill and diamond collection (game_collect_pills)
+    ProfileStageEntities, // Enemies and projectiles (game_update_entities)
+    ProfileStageLayer,    // Background tiles, clouds and blocks
+    ProfileStageCells,    // Pills, diamonds and entities
+    ProfileStageGrid,     // Grid overlay
+    ProfileStageHud,      // Statistics
+    ProfileStageCount,
+} ProfileStage;
+
+#ifdef PANIS_PROFILER
+
+// Time the code between PROFILE_BEGIN and PROFILE_END of the same stage in
+// one scope with the DWT cycle counter
+#define PROFILE_BEGIN(stage) const uint32_t profile_start_##stage = DWT->CYCCNT
+#define PROFILE_END(stage) profiler_record(stage, DWT->CYCCNT - profile_start_##stage)
+
+// Enable the cycle counter and reset all statistics
+void profiler_init(void);
+
+// Add a measurement to the current window of a stage. Every stage must only
+// be recorded from one thread.
+void profiler_record(ProfileStage stage, uint32_t cycles);
+
+// Count a drawn frame, closes the statistics window every second
+void profiler_frame(void);
+
+// Draw min/avg/max microseconds of the last window per stage and the FPS
+void profiler_draw(Canvas* canvas);
+
+// Distribution of the measurements of a stage since profiler_histograms_start,
+// in microseconds. Percentiles are upper bounds of histogram buckets, a
+// quarter octave wide.
+typedef struct {
+    uint32_t samples;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} ProfileSummary;
+
+// Clear the histograms and start filling them, in addition to the windows
+void profiler_histograms_start(void);
+
+// Stop filling the histograms
+void profiler_histograms_stop(void);
+
+// Summarize the histogram of a stage
+void profiler_summarize(ProfileStage stage, ProfileSummary* summary);
+
+// Short name of a stage, as on the profiler screen
+const char* profiler_stage_name(ProfileStage stage);
+
+#else
+
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+
+#endif
@@ -0,0 +1,156 @@
+#include "resume_file.h"
+#include "arena.h"
+
+#include <stddef.h>
+
+#define TAG "PanisResume"
+
+#define RESUME_FILE_HEADER_SIZE 12
+#define RESUME_FIXED_SIZE 60  // Progress before the per chunk arrays
+#define RESUME_CHUNK_SIZE(chunks) (((chunks) + 7) / 8 + (chunks) + 8 * (chunks))
+#define RESUME_PROGRESS_SIZE(chunks) (RESUME_FIXED_SIZE + RESUME_CHUNK_SIZE(chunks))
+#define RESUME_FILE_MAX_SIZE (RESUME_FILE_HEADER_SIZE + RESUME_PROGRESS_SIZE(MAX_LEVEL_CHUNKS))
+
+// One byte more is read, so a longer file is noticed
+_Static_assert(RESUME_FILE_MAX_SIZE + 1 <= ARENA_BUDGET_RESUME, "Resume file exceeds its arena budget");
+
+// Little endian fields, each call advances the position past the field
+static void put_le(uint8_t** pos, uint64_t value, int size) {
+    for(int i = 0; i < size; i++) {
+        *(*pos)++ = value >> (8 * i);
+    }
+}
+
+static uint64_t get_le(const uint8_t** pos, int size) {
+    uint64_t value = 0;
+    for(int i = 0; i < size; i++) {
+        value |= (uint64_t)*(*pos)++ << (8 * i);
+    }
+    return value;
+}
+
+static void put_bytes(uint8_t** pos, const uint8_t* bytes, size_t size) {
+    memcpy(*pos, bytes, size);
+    *pos += size;
+}
+
+static void get_bytes(const uint8_t** pos, uint8_t* bytes, size_t size) {
+    memcpy(bytes, *pos, size);
+    *pos += size;
+}
+
+// The signed 32 bit fields of GameProgress, in file order
+static const uint16_t counter_offsets[] = {
+    offsetof(GameProgress, world_x),
+    offsetof(GameProgress, x_fraction),
+    offsetof(GameProgress, screen_x),
+    offsetof(GameProgress, camera_x),
+    offsetof(GameProgress, y_fixed),
+    offsetof(GameProgress, y_velocity),
+    offsetof(GameProgress, score),
+    offsetof(GameProgress, block_count),
+    offsetof(GameProgress, pill_count),
+    offsetof(GameProgress, overall_pills),
+    offsetof(GameProgress, overall_diamonds),
+    offsetof(GameProgress, filled_diamonds),
+    offsetof(GameProgress, ground_blocks),
+};
+
+// Level id, chunk count and the two flags, then the signed fields
+_Static_assert(8 + COUNT_OF(counter_offsets) * 4 == RESUME_FIXED_SIZE, "Resume layout changed");
+
+bool resume_file_save(
+    Storage* storage,
+    const char* path,
+    InputLogLevel level,
+    uint32_t seed,
+    const GameProgress* progress) {
+    int chunks = MIN(progress->level_chunks, MAX_LEVEL_CHUNKS);
+    size_t size = RESUME_PROGRESS_SIZE(chunks);
+    uint8_t* data = arena_alloc(ArenaResume, RESUME_FILE_MAX_SIZE);
+    uint8_t* pos = data;
+    put_bytes(&pos, (const uint8_t*)"PNRS", 4);
+    put_le(&pos, RESUME_FILE_VERSION, 1);
+    put_le(&pos, level, 1);
+    put_le(&pos, size, 2);
+    put_le(&pos, seed, 4);
+    put_le(&pos, progress->level_id, 4);
+    put_le(&pos, chunks, 2);
+    put_le(&pos, progress->facing_right, 1);
+    put_le(&pos, progress->on_ground, 1);
+    for(size_t i = 0; i < COUNT_OF(counter_offsets); i++) {
+        int32_t value;
+        memcpy(&value, (const uint8_t*)progress + counter_offsets[i], sizeof(value));
+        put_le(&pos, (uint32_t)value, 4);
+    }
+    put_bytes(&pos, progress->chunk_counted, (chunks + 7) / 8);
+    put_bytes(&pos, progress->chunk_defeated, chunks);
+    for(int i = 0; i < chunks; i++) {
+        put_le(&pos, progress->collected[i], 8);
+    }
+    size_t file_size = pos - data;
+    
+    File* file = storage_file_alloc(storage);
+    bool saved = storage_file_open(file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS) &&
+                 storage_file_write(file, data, file_size) == file_size;
+    storage_file_close(file);
+    storage_file_free(file);
+    arena_reset(ArenaResume);
+    if(!saved) {
+        FURI_LOG_W(TAG, "Can't save %s", path);
+    }
+    return saved;
+}
+
+// Check the header and the size of the progress that follows it
+static bool check_header(const uint8_t* data, size_t file_size) {
+    if(file_size < RESUME_FILE_HEADER_SIZE + RESUME_FIXED_SIZE || memcmp(data, "PNRS", 4) != 0 ||
+       data[4] != RESUME_FILE_VERSION) {
+        return false;
+    }
+    size_t size = data[6] | (data[7] << 8);
+    size_t chunks = data[16] | (data[17] << 8);
+    return chunks <= MAX_LEVEL_CHUNKS && size == RESUME_PROGRESS_SIZE(chunks) &&
+           file_size == RESUME_FILE_HEADER_SIZE + size;
+}
+
+bool resume_file_load(
+    Storage* storage,
+    const char* path,
+    InputLogLevel* level,
+    uint32_t* seed,
+    GameProgress* progress) {
+    uint8_t* data = arena_alloc(ArenaResume, RESUME_FILE_MAX_SIZE + 1);
+    File* file = storage_file_alloc(storage);
+    size_t file_size = 0;
+    if(storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        file_size = storage_file_read(file, data, RESUME_FILE_MAX_SIZE + 1);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    bool valid = check_header(data, file_size);
+    if(valid) {
+        const uint8_t* pos = &data[5];
+        memset(progress, 0, sizeof(GameProgress));
+        *level = get_le(&pos, 1);
+        pos += 2;  // Progress size, checked
+        *seed = get_le(&pos, 4);
+        progress->level_id = get_le(&pos, 4);
+        progress->level_chunks = get_le(&pos, 2);
+        progress->facing_right = get_le(&pos, 1);
+        progress->on_ground = get_le(&pos, 1);
+        for(size_t i = 0; i < COUNT_OF(counter_offsets); i++) {
+            int32_t value = (int32_t)get_le(&pos, 4);
+            memcpy((uint8_t*)progress + counter_offsets[i], &value, sizeof(value));
+        }
+        int chunks = progress->level_chunks;
+        get_bytes(&pos, progress->chunk_counted, (chunks + 7) / 8);
+        get_bytes(&pos, progress->chunk_defeated, chunks);
+        for(int i = 0; i < chunks; i++) {
+            progress->collected[i] = get_le(&pos, 8);
+        }
+        FURI_LOG_I(TAG, "Resuming from %s", path);
+    }
+    arena_reset(ArenaResume);
+    return valid;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <furi.h>
+#include <storage/storage.h>
+
+#include "game.h"
+#include "input_log.h"
+
+// Progress saved on exit and continued on the next launch. The file is
+// written and read in one go. All values are little endian.
+//
+//  Offset     Size       Content
+//  0          4          Magic "PNRS"
+//  4          1          Format version (RESUME_FILE_VERSION)
+//  5          1          Level source (InputLogLevel)
+//  6          2          Size of the progress that follows
+//  8          4          Level seed
+//  12         4          GameProgress.level_id
+//  16         2          level_chunks N, at most MAX_LEVEL_CHUNKS
+//  18         1          facing_right
+//  19         1          on_ground
+//  20         4*13       world_x, x_fraction, screen_x, camera_x, y_fixed,
+//                        y_velocity, score, block_count, pill_count,
+//                        overall_pills, overall_diamonds, filled_diamonds,
+//                        ground_blocks; signed
+//  72         (N+7)/8    chunk_counted
+//  ...        N          chunk_defeated
+//  ...        8*N        collected
+//
+// A file of another version, or whose progress size doesn't match N, is
+// ignored. game_resume also rejects progress of another level.
+
+#define RESUME_FILE_PATH APP_DATA_PATH("resume.pns")
+#define RESUME_FILE_VERSION 4  // Bump whenever the layout or the level generation changes
+
+// Save the progress of a level, replaces an older save
+bool resume_file_save(
+    Storage* storage,
+    const char* path,
+    InputLogLevel level,
+    uint32_t seed,
+    const GameProgress* progress);
+
+// Read saved progress. Returns false if there is none or it is invalid.
+bool resume_file_load(
+    Storage* storage,
+    const char* path,
+    InputLogLevel* level,
+    uint32_t* seed,
+    GameProgress* progress);
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Convert a large illustration into a compressed 1-bit bitmap for the SD card.
+
+The image is scaled to fit the 128x64 screen, keeping its aspect ratio, and
+thresholded to black and white. Its XBM rows (least significant bit first,
+every row padded to whole bytes, 1 = black) are PackBits coded:
+
+    control 0..127    the next control + 1 bytes are literal
+    control 128..255  the next byte repeats control - 126 times
+
+File layout, little endian:
+
+    0   4  magic "PNBM"
+    4   1  version 1
+    5   1  width in pixels
+    6   1  height in pixels
+    7   1  reserved, 0
+    8   2  size of the coded data
+    10     coded data
+
+Needs Pillow, which the Flipper build tools already install.
+
+Usage: art_compiler.py <image> <output.pnb>
+"""
+
+import os
+import struct
+import sys
+
+VERSION = 1
+MAX_WIDTH = 128
+MAX_HEIGHT = 64
+THRESHOLD = 160  # Gray levels below are black, keeps thin ink lines
+
+
+def load_bitmap(path):
+    from PIL import Image
+
+    image = Image.open(path).convert("L")
+    image.thumbnail((MAX_WIDTH, MAX_HEIGHT), Image.LANCZOS)
+    width, height = image.size
+    pixels = image.load()
+    return width, height, [[pixels[x, y] < THRESHOLD for x in range(width)] for y in range(height)]
+
+
+def pack_xbm(width, rows):
+    data = bytearray()
+    stride = (width + 7) // 8
+    for row in rows:
+        line = bytearray(stride)
+        for x, black in enumerate(row):
+            if black:
+                line[x // 8] |= 1 << (x % 8)
+        data += line
+    return bytes(data)
+
+
+def packbits(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        run = 1
+        while pos + run < len(data) and run < 129 and data[pos + run] == data[pos]:
+            run += 1
+        if run >= 2:
+            out += bytes([run + 126, data[pos]])
+            pos += run
+            continue
+        start = pos
+        while pos < len(data) and pos - start < 128:
+            if pos + 1 < len(data) and data[pos + 1] == data[pos]:
+                break
+            pos += 1
+        if pos == start:
+            pos += 1
+        out += bytes([pos - start - 1]) + data[start:pos]
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    width, height, rows = load_bitmap(sys.argv[1])
+    coded = packbits(pack_xbm(width, rows))
+    os.makedirs(os.path.dirname(os.path.abspath(sys.argv[2])), exist_ok=True)
+    with open(sys.argv[2], "wb") as f:
+        f.write(b"PNBM" + struct.pack("<BBBBH", VERSION, width, height, 0, len(coded)))
+        f.write(coded)
+
+
+if __name__ == "__main__":
+    main()
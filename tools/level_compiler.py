@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Compile a text level description into const C data for builtin_level.h.
+
+The level file has one line per grid row, top to bottom, one character per
+cell. Lines starting with '#' are comments, a line 'tiles: 0 1 2' sets the
+background tile list. Rows shorter than the longest one are padded with
+empty cells, the width is padded to whole chunks.
+
+    .  empty      #  block    o  pill
+    d  diamond    D  filled diamond    ~  cloud
+
+Usage: level_compiler.py <level.txt> <builtin_level.c>
+"""
+
+import os
+import sys
+import zlib
+
+ROWS = 6
+CHUNK_COLS = 8
+CELL_TYPES = {".": 0, "#": 1, "o": 2, "d": 3, "D": 4, "~": 5}
+PLANES = 5
+
+
+def parse(path):
+    rows = []
+    tiles = [0, 1, 2]
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.rstrip("\n")
+            if not line.strip() or line.startswith("#"):
+                continue
+            if line.startswith("tiles:"):
+                tiles = [int(tile) for tile in line[len("tiles:"):].split()]
+                continue
+            for col, char in enumerate(line):
+                if char not in CELL_TYPES:
+                    sys.exit(f"{path}:{number}:{col + 1}: unknown cell '{char}'")
+            rows.append(line)
+    if len(rows) != ROWS:
+        sys.exit(f"{path}: expected {ROWS} rows, got {len(rows)}")
+    if not tiles or any(tile < 0 or tile > 255 for tile in tiles):
+        sys.exit(f"{path}: invalid tile list")
+    width = max(len(row) for row in rows)
+    width = (width + CHUNK_COLS - 1) // CHUNK_COLS * CHUNK_COLS
+    return [row.ljust(width, ".") for row in rows], tiles
+
+
+def compile_chunks(rows):
+    chunks = []
+    for start in range(0, len(rows[0]), CHUNK_COLS):
+        planes = [[0] * ROWS for _ in range(PLANES)]
+        for row in range(ROWS):
+            for col in range(CHUNK_COLS):
+                cell = CELL_TYPES[rows[row][start + col]]
+                if cell:
+                    planes[cell - 1][row] |= 1 << col
+        chunks.append(planes)
+    return chunks
+
+
+def level_id(chunks, tiles):
+    """CRC-32 of the compiled data, saved progress of another level is ignored."""
+    data = bytes(tiles) + bytes(bits for planes in chunks for plane in planes for bits in plane)
+    return zlib.crc32(data)
+
+
+def write(path, source, chunks, tiles):
+    with open(path, "w") as f:
+        f.write(f"// Generated from {os.path.basename(source)} by tools/level_compiler.py, do not edit\n")
+        f.write('#include "builtin_level.h"\n\n')
+        f.write(f"static const uint8_t tiles[{len(tiles)}] = {{")
+        f.write(", ".join(str(tile) for tile in tiles))
+        f.write("};\n\n")
+        f.write(f"static const BuiltinChunk chunks[{len(chunks)}] = {{\n")
+        for planes in chunks:
+            f.write("    {{\n")
+            for plane in planes:
+                f.write("        {" + ", ".join(f"0x{bits:02x}" for bits in plane) + "},\n")
+            f.write("    }},\n")
+        f.write("};\n\n")
+        f.write("const BuiltinLevel builtin_level = {\n")
+        f.write(f"    .num_chunks = {len(chunks)},\n")
+        f.write(f"    .num_tiles = {len(tiles)},\n")
+        f.write("    .tiles = tiles,\n")
+        f.write("    .chunks = chunks,\n")
+        f.write(f"    .id = 0x{level_id(chunks, tiles):08x},\n")
+        f.write("};\n")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    rows, tiles = parse(sys.argv[1])
+    write(sys.argv[2], sys.argv[1], compile_chunks(rows), tiles)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Print a trace dump written by the app (apps_data/mitzi_panis/trace.pnt).
+
+One line per record, oldest first: time in microseconds since the first
+record, time since the previous record, the event and its arguments. The
+cycle counter wraps after about a minute; records are in order, so every
+step back in time counts as one wrap.
+
+Usage: trace_dump.py <trace.pnt>
+"""
+
+import struct
+import sys
+
+VERSION = 1
+HEADER = struct.Struct("<4sBBHI")
+RECORD = struct.Struct("<IHHI")
+
+# Event names and argument names, in the order of TraceEvent in trace.h
+EVENTS = [
+    ("frame", "steps", "total"),
+    ("step", "y", "cycles"),
+    ("collect", "events", "score"),
+    ("feedback", "effect", None),
+    ("note", "melody", "hz"),
+    ("draw", None, "cycles"),
+    ("input", "key", "type"),
+    ("sleep", None, None),
+    ("wake", None, None),
+]
+
+
+def read(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, version, size, count, cycles_per_us = HEADER.unpack_from(data)
+    if magic != b"PNTR" or version != VERSION or size != RECORD.size:
+        sys.exit(f"{path}: not a trace dump of version {VERSION}")
+    records = []
+    for i in range(count):
+        offset = HEADER.size + i * RECORD.size
+        if offset + RECORD.size > len(data):
+            break
+        records.append(RECORD.unpack_from(data, offset))
+    return records, cycles_per_us
+
+
+def format_args(event, arg0, arg1):
+    if event >= len(EVENTS):
+        return f"event{event} {arg0} {arg1}"
+    name, name0, name1 = EVENTS[event]
+    if name == "step":
+        arg0 = struct.unpack("<h", struct.pack("<H", arg0))[0]  # Y can be above the screen
+    parts = [name]
+    if name0:
+        parts.append(f"{name0}={arg0}")
+    if name1:
+        parts.append(f"{name1}={arg1}")
+    return " ".join(parts)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    records, cycles_per_us = read(sys.argv[1])
+    base = 0
+    last = None
+    first = None
+    for cycles, event, arg0, arg1 in records:
+        if last is not None and cycles + base < last:
+            base += 1 << 32
+        time = cycles + base
+        if first is None:
+            first = last = time
+        print(f"{(time - first) // cycles_per_us:10d} us  +{(time - last) // cycles_per_us:7d}  "
+              f"{format_args(event, arg0, arg1)}")
+        last = time
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#include "trace.h"
+
+#include <furi_hal.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define TAG "PanisTrace"
+
+#define TRACE_HEADER_SIZE 12
+#define TRACE_MASK (TRACE_RECORDS - 1)
+
+typedef struct {
+    uint32_t cycles;  // DWT cycle counter
+    uint16_t event;   // TraceEvent
+    uint16_t arg0;
+    uint32_t arg1;
+} TraceRecord;
+
+_Static_assert(sizeof(TraceRecord) == 12, "Trace records are written as they are");
+_Static_assert((TRACE_RECORDS & TRACE_MASK) == 0, "TRACE_RECORDS must be a power of two");
+
+static TraceRecord ring[TRACE_RECORDS];
+static atomic_uint_least32_t head;  // Records written in total
+static atomic_bool paused;          // Set while dumping
+
+void trace_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    memset(ring, 0, sizeof(ring));
+    atomic_init(&head, 0);
+    atomic_init(&paused, false);
+}
+
+void trace_record(TraceEvent event, uint16_t arg0, uint32_t arg1) {
+    if(atomic_load_explicit(&paused, memory_order_relaxed)) {
+        return;
+    }
+    uint32_t index = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+    TraceRecord* record = &ring[index & TRACE_MASK];
+    record->cycles = DWT->CYCCNT;
+    record->event = event;
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+}
+
+bool trace_dump(Storage* storage, const char* path) {
+    atomic_store(&paused, true);
+    uint32_t end = atomic_load(&head);
+    uint32_t count = (end < TRACE_RECORDS) ? end : TRACE_RECORDS;
+    uint32_t first = (end - count) & TRACE_MASK;
+    
+    uint8_t header[TRACE_HEADER_SIZE] = {'P', 'N', 'T', 'R', TRACE_VERSION, sizeof(TraceRecord)};
+    uint32_t cycles_per_us = furi_hal_cortex_instructions_per_microsecond();
+    header[6] = count & 0xFF;
+    header[7] = count >> 8;
+    for(int i = 0; i < 4; i++) {
+        header[8 + i] = cycles_per_us >> (8 * i);
+    }
+    
+    // The ring wraps at most once, write the part up to its end first
+    size_t first_part = (first + count > TRACE_RECORDS) ? TRACE_RECORDS - first : count;
+    size_t second_part = count - first_part;
+    File* file = storage_file_alloc(storage);
+    bool written =
+        storage_file_open(file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS) &&
+        storage_file_write(file, header, sizeof(header)) == sizeof(header) &&
+        storage_file_write(file, &ring[first], first_part * sizeof(TraceRecord)) ==
+            first_part * sizeof(TraceRecord) &&
+        storage_file_write(file, &ring[0], second_part * sizeof(TraceRecord)) ==
+            second_part * sizeof(TraceRecord);
+    storage_file_close(file);
+    storage_file_free(file);
+    atomic_store(&paused, false);
+    
+    if(written) {
+        FURI_LOG_I(TAG, "%lu records written to %s", (unsigned long)count, path);
+    } else {
+        FURI_LOG_W(TAG, "Can't write %s", path);
+    }
+    return written;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <furi.h>
+#include <storage/storage.h>
+
+// Trace of gameplay and timing events: compact binary records in a fixed
+// ring in RAM, cheap enough to stay enabled in every build. A record costs
+// an atomic increment and four stores, nothing is formatted until the ring
+// is dumped. tools/trace_dump.py prints a dump.
+//
+// Dump file, little endian:
+//
+//  Offset     Size       Content
+//  0          4          Magic "PNTR"
+//  4          1          Format version (TRACE_VERSION)
+//  5          1          Record size (12)
+//  6          2          Number of records N
+//  8          4          CPU cycles per microsecond
+//  12         12*N       Records, oldest first: cycles (u32), event (u16),
+//                        argument 0 (u16), argument 1 (u32)
+
+#define TRACE_PATH APP_DATA_PATH("trace.pnt")
+#define TRACE_VERSION 1
+#define TRACE_RECORDS 256  // Ring size, a power of two
+
+// Traced events and their arguments
+typedef enum {
+    TraceFrame,     // Game loop frame done: physics steps run, steps in total
+    TraceStep,      // Physics step done: y position, CPU cycles it took
+    TraceCollect,   // Pill or diamond collected: GameEvent bits, score
+    TraceFeedback,  // Feedback dispatched: Feedback, 0
+    TraceNote,      // Audio note started: 1 for the melody, frequency in Hz
+    TraceDraw,      // Draw callback done: 0, CPU cycles it took
+    TraceInput,     // Key event handled: InputKey, InputType
+    TraceSleep,     // Game loop went to sleep until input: 0, 0
+    TraceWake,      // Game loop woke up: 0, 0
+} TraceEvent;
+
+// Enable the cycle counter and empty the ring
+void trace_init(void);
+
+// Add a record, from any thread. The oldest record is overwritten when the
+// ring is full.
+void trace_record(TraceEvent event, uint16_t arg0, uint32_t arg1);
+
+// Write the records in the ring, oldest first. Tracing is paused meanwhile.
+bool trace_dump(Storage* storage, const char* path);